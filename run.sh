@@ -13,7 +13,7 @@ BASENAME=$(basename "$SOURCE" .aur)
 ./build/aurorac "$SOURCE" -o "build/${BASENAME}.o" --emit-ll "build/${BASENAME}.ll" || exit 1
 
 # Link with runtime
-clang -no-pie "build/${BASENAME}.o" build/CMakeFiles/aurora_runtime.dir/stdlib/aurora_runtime.c.o -o "build/${BASENAME}" || exit 1
+clang -no-pie "build/${BASENAME}.o" build/CMakeFiles/aurora_runtime.dir/stdlib/aurora_runtime.c.o -pthread -o "build/${BASENAME}" || exit 1
 
 # Run the program
 echo "Running ${BASENAME}:"
@@ -8,6 +8,7 @@
 struct Type;
 
 struct Expr {
+  std::unique_ptr<Type> ty; // filled in by Sema::infer
   virtual ~Expr()=default;
 };
 using ExprPtr = std::unique_ptr<Expr>;
@@ -19,11 +20,25 @@ using StmtPtr = std::unique_ptr<Stmt>;
 
 struct EInt : Expr { std::int64_t v; explicit EInt(std::int64_t v):v(v){} };
 struct EBool: Expr { bool v; explicit EBool(bool v):v(v){} };
+struct EStr : Expr { std::string v; explicit EStr(std::string v):v(std::move(v)){} }; // file paths only
 struct EVar : Expr { std::string name; explicit EVar(std::string n):name(std::move(n)){} };
 struct EUnary: Expr { TokKind op; ExprPtr rhs; EUnary(TokKind op, ExprPtr e):op(op),rhs(std::move(e)){} };
 struct EBin  : Expr { TokKind op; ExprPtr lhs,rhs; EBin(ExprPtr a, TokKind op, ExprPtr b):op(op),lhs(std::move(a)),rhs(std::move(b)){} };
-struct ECall : Expr { std::string callee; std::vector<ExprPtr> args; explicit ECall(std::string c):callee(std::move(c)){} };
+// Ordering argument of the atomic builtins: relaxed, acquire, release, acq_rel, seq_cst.
+enum class MemOrder { Relaxed, Acquire, Release, AcqRel, SeqCst };
+struct ECall : Expr {
+  std::string callee; std::vector<ExprPtr> args;
+  std::vector<std::unique_ptr<Type>> typeArgs; // builtin<T>(...) forms, e.g. alloc<i32>(n)
+  std::vector<std::int64_t> imm;               // constant operands folded by Sema (shuffle lanes, MemOrders)
+  int line=0;                                  // of the callee name; 0 for calls Sema synthesizes
+  explicit ECall(std::string c):callee(std::move(c)){}
+};
 struct EArrayLit : Expr { std::vector<ExprPtr> elems; explicit EArrayLit(std::vector<ExprPtr> e):elems(std::move(e)){} };
+struct EArrayRepeat : Expr { ExprPtr value, count; std::int64_t n=0; /* count folded by Sema */ EArrayRepeat(ExprPtr v, ExprPtr c):value(std::move(v)),count(std::move(c)){} };
+struct EField : Expr { ExprPtr base; std::string name; int index=-1; /* declared position, set by Sema */ EField(ExprPtr b, std::string n):base(std::move(b)),name(std::move(n)){} };
+struct EStruct : Expr { std::string name; std::vector<std::pair<std::string, ExprPtr>> inits; explicit EStruct(std::string n):name(std::move(n)){} };
+// spawn f(args): runs the call as a task on the thread pool; the value is a future<T> for join(f)
+struct ESpawn : Expr { ExprPtr call; explicit ESpawn(ExprPtr c):call(std::move(c)){} };
 struct EIndex : Expr { ExprPtr arr; ExprPtr idx; EIndex(ExprPtr a, ExprPtr i):arr(std::move(a)),idx(std::move(i)){} };
 
 struct SLet : Stmt {
@@ -31,6 +46,8 @@ struct SLet : Stmt {
   std::unique_ptr<Type> annType; // may be null
   ExprPtr init;
   bool isUnique=false; // unique<T> sugar
+  ExprPtr cleanup;     // unique: the call Sema attaches to run at scope exit, e.g. free(name)
+  bool onStack=false;  // unique alloc<T>(constant) that never escapes; CodeGen may use a stack slot
   SLet(std::string n, std::unique_ptr<Type> t, ExprPtr e, bool u=false)
     :name(std::move(n)),annType(std::move(t)),init(std::move(e)),isUnique(u){}
 };
@@ -38,20 +55,86 @@ struct SLet : Stmt {
 struct SExpr : Stmt { ExprPtr e; explicit SExpr(ExprPtr e):e(std::move(e)){} };
 struct SReturn: Stmt { ExprPtr e; explicit SReturn(ExprPtr e):e(std::move(e)){} };
 struct SIf    : Stmt { ExprPtr cond; std::vector<StmtPtr> thenStmts, elseStmts; };
-struct SWhile : Stmt { ExprPtr cond; std::vector<StmtPtr> body; };
+// Loop attributes; CodeGen turns them into llvm.loop metadata on the latch.
+struct LoopHints {
+  bool vectorize=false; int vectorizeWidth=0; // #[vectorize] / #[vectorize(width=N)]
+  int unroll=0;                               // #[unroll(N)]; 1 disables unrolling
+  int interleave=0;                           // #[interleave(N)]
+  bool independent=false;                     // #[independent]: iterations share no memory dependences
+};
+struct SWhile : Stmt { ExprPtr cond; std::vector<StmtPtr> body; LoopHints hints; };
+// for var in from..to step s { body }: var counts from `from` up to, not including, `to`.
+// Sema folds the step (a positive constant, default 1) into stepValue; var is read-only.
+// `parallel for` runs iterations on the runtime's thread pool; each reduction variable gets a
+// private accumulator per chunk that is combined into the shared one when the chunk ends.
+struct Reduction { std::string op; std::string var; }; // op: + * min max
+// `for x in g(args)` instead consumes the generator call in `gen`; from and to are then null.
+struct SFor : Stmt {
+  std::string var; ExprPtr from, to, step, gen; std::vector<StmtPtr> body; LoopHints hints;
+  std::int64_t stepValue = 1;
+  bool parallel = false;
+  std::vector<Reduction> reductions;
+  std::vector<std::string> captures; // enclosing locals the body uses, in first-use order (Sema)
+  std::vector<std::string> atomicCaptures; // captures holding atomics; used in place, never copied
+};
 struct SDefer : Stmt { ExprPtr e; explicit SDefer(ExprPtr e):e(std::move(e)){} };
 struct SBreak : Stmt {};
 struct SContinue : Stmt {};
+struct SSync : Stmt {}; // sync; waits for every task this call of the function spawned
+struct SYield : Stmt { ExprPtr e; explicit SYield(ExprPtr e):e(std::move(e)){} }; // yield e; in a gen fn
+
+// Array parameters are passed by reference, slices as (data, len). `noalias` is set by Sema
+// when no call site passes the same storage to two reference parameters.
+struct Param { std::string name; std::unique_ptr<Type> ty; bool noalias=false; };
 
-struct Param { std::string name; std::unique_ptr<Type> ty; };
+// #[name] or #[name(key=value, value)] in front of a declaration.
+struct Attr { std::string name; std::vector<std::pair<std::string, std::int64_t>> args; };
+
+// Fields are declared in source order; CodeGen reorders them by alignment to minimize padding
+// unless keepOrder is set. soa stores T[N] and vec<T> of this struct as one array per field.
+struct StructDecl {
+  std::string name;
+  std::vector<Param> fields;
+  bool keepOrder=false, soa=false;
+};
+
+// Inferred by Sema over the whole-program call graph; CodeGen maps these to LLVM function attributes.
+struct FnEffects {
+  bool pure=false;      // touches no memory visible to the caller: memory(none)
+  bool readOnly=false;  // may read but never write caller-visible memory: memory(read)
+  bool noUnwind=true;   // Aurora has no exceptions and the runtime is plain C
+  bool willReturn=false;
+  bool recursive=true;  // conservative until the call graph says otherwise
+};
 
 struct Func {
   std::string name;
+  bool isConst=false; // const fn: callable from constant expressions
+  bool isExport=false; // keeps external linkage and the C calling convention
+  bool spawns=false;   // body contains spawn; its tasks are waited for before it returns (Sema)
+  bool isGen=false;    // gen fn: yields a stream of `ret` values to a for loop
+  FnEffects effects;
   std::vector<Param> params;
   std::unique_ptr<Type> ret;
   std::vector<StmtPtr> body;
 };
 
+// Compile-time value computed by Sema's constant evaluator (bools are 0/1).
+struct ConstValue {
+  std::int64_t v=0;
+  bool isBool=false, isArray=false;
+  std::vector<ConstValue> elems;
+};
+
+struct ConstDecl {
+  std::string name;
+  std::unique_ptr<Type> ty; // annotation; filled in by Sema when omitted
+  ExprPtr init;
+  ConstValue value;         // filled in by Sema
+};
+
 struct Program {
+  std::vector<std::unique_ptr<StructDecl>> structs;
+  std::vector<std::unique_ptr<ConstDecl>> consts;
   std::vector<std::unique_ptr<Func>> funcs;
 };
@@ -4,8 +4,13 @@
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/IRBuilder.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/MDBuilder.h>
+#include <llvm/IR/DiagnosticInfo.h>
+#include <llvm/IR/DiagnosticPrinter.h>
+#include <llvm/Analysis/VectorUtils.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Passes/PassBuilder.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/DerivedTypes.h>
 #include <llvm/Support/FileSystem.h>
@@ -15,26 +20,90 @@
 #include <llvm/Target/TargetOptions.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Support/raw_ostream.h>
+#include <algorithm>
+#include <unordered_set>
 
 
 struct BuilderWrap : llvm::IRBuilder<> { explicit BuilderWrap(llvm::LLVMContext& C):llvm::IRBuilder<>(C){} };
 
-CodeGen::CodeGen(const std::string& name){
+CodeGen::CodeGen(const std::string& name, const std::string& cpu){
   ctx = std::make_unique<llvm::LLVMContext>();
   mod = std::make_unique<llvm::Module>(name, *ctx);
   builder = std::make_unique<BuilderWrap>(*ctx);
 
+  // the target is needed up front: the optimizer queries it for costs and the DataLayout
+  llvm::InitializeNativeTarget(); llvm::InitializeNativeTargetAsmPrinter(); llvm::InitializeNativeTargetAsmParser();
+  auto targetTriple = llvm::sys::getDefaultTargetTriple();
+  mod->setTargetTriple(targetTriple);
+  std::string Error; auto Target = llvm::TargetRegistry::lookupTarget(targetTriple, Error);
+  if (!Target) fatal(Error);
+  llvm::TargetOptions opt; auto RM = std::optional<llvm::Reloc::Model>();
+  // the CPU decides the widest legal vector: simd<i64,4> is one AVX2 register, two SSE ones
+  auto cpuName = cpu=="native" ? llvm::sys::getHostCPUName().str() : cpu;
+  tm.reset(Target->createTargetMachine(targetTriple, cpuName, "", opt, RM));
+  mod->setDataLayout(tm->createDataLayout());
+
   // declare libc functions used by runtime/builtins
   auto i32 = llvm::Type::getInt32Ty(*ctx);
   auto i64 = llvm::Type::getInt64Ty(*ctx);
   auto i8p = llvm::Type::getInt8PtrTy(*ctx);
   declareBuiltin("printf",{i8p}, i32, /*vararg*/true);
   declareBuiltin("malloc",{i64}, i8p, false);
+  declareBuiltin("calloc",{i64, i64}, i8p, false);
   declareBuiltin("free",{i8p}, llvm::Type::getVoidTy(*ctx), false);
   
   // declare Aurora runtime functions
-  declareBuiltin("print_i64",{i64}, i64, false);
-  declareBuiltin("read_i64",{}, i64, false);
+  declareBuiltin("print_i64",{i64}, i64, false)->setDoesNotThrow();
+  declareBuiltin("read_i64",{}, i64, false)->setDoesNotThrow();
+  // bulk I/O takes the slice as (data, len) plus the element count
+  auto voidTy = llvm::Type::getVoidTy(*ctx);
+  declareBuiltin("aurora_read_array_i64",{i8p, i64, i64}, voidTy, false)->setDoesNotThrow();
+  declareBuiltin("aurora_print_array_i64",{i8p, i64, i64, i64}, voidTy, false)->setDoesNotThrow();
+  // arenas: only arena_alloc's full-chunk path reaches the runtime per allocation
+  declareBuiltin("aurora_arena_new",{i64}, i8p, false)->setDoesNotThrow();
+  auto arenaGrow = declareBuiltin("aurora_arena_grow",{i8p, i64, i64, i64}, i8p, false);
+  arenaGrow->setDoesNotThrow(); arenaGrow->addFnAttr(llvm::Attribute::Cold);
+  declareBuiltin("aurora_arena_reset",{i8p, i64}, voidTy, false)->setDoesNotThrow();
+  declareBuiltin("aurora_arena_free",{i8p}, voidTy, false)->setDoesNotThrow();
+  auto poolRefill = declareBuiltin("aurora_pool_refill",{i64}, i8p, false);
+  poolRefill->setDoesNotThrow(); poolRefill->addFnAttr(llvm::Attribute::Cold);
+  // alloc_large: (count, elem size, hugepages)
+  declareBuiltin("aurora_alloc_large",{i64, i64, i32}, i8p, false)->setDoesNotThrow();
+  declareBuiltin("aurora_free_large",{i8p}, voidTy, false)->setDoesNotThrow();
+  // --alloc-profile hooks; the trailing i64 is the call's source line
+  declareBuiltin("aurora_prof_malloc",{i64, i64}, i8p, false)->setDoesNotThrow();
+  declareBuiltin("aurora_prof_calloc",{i64, i64, i64}, i8p, false)->setDoesNotThrow();
+  declareBuiltin("aurora_prof_free",{i8p}, voidTy, false)->setDoesNotThrow();
+  declareBuiltin("aurora_prof_alloc_large",{i64, i64, i32, i64}, i8p, false)->setDoesNotThrow();
+  declareBuiltin("aurora_prof_free_large",{i8p}, voidTy, false)->setDoesNotThrow();
+  declareBuiltin("aurora_prof_note",{i64, i64}, voidTy, false)->setDoesNotThrow();
+  // map_array/unmap/write_array_bin: (path, elem size, hint bits, out count), (data, len, elem size),
+  // (path, data, len, count, elem size)
+  declareBuiltin("aurora_map_file",{i8p, i64, i64, i8p}, i8p, false)->setDoesNotThrow();
+  declareBuiltin("aurora_unmap",{i8p, i64, i64}, voidTy, false)->setDoesNotThrow();
+  declareBuiltin("aurora_write_file",{i8p, i8p, i64, i64, i64}, voidTy, false)->setDoesNotThrow();
+
+  // vec<T> growth and release live in the runtime; everything else is inlined
+  auto grow = declareBuiltin("aurora_vec_grow",{i8p, i64, i64}, voidTy, false);
+  grow->setDoesNotThrow(); grow->addFnAttr(llvm::Attribute::Cold);
+  auto growSoa = declareBuiltin("aurora_vec_grow_soa",{i8p, i8p, i64, i64}, voidTy, false);
+  growSoa->setDoesNotThrow(); growSoa->addFnAttr(llvm::Attribute::Cold);
+  declareBuiltin("aurora_vec_free",{i8p, i64}, voidTy, false)->setDoesNotThrow();
+  auto empty = declareBuiltin("aurora_vec_pop_empty",{}, voidTy, false);
+  empty->setDoesNotThrow(); empty->setDoesNotReturn(); empty->addFnAttr(llvm::Attribute::Cold);
+  // parallel for: (body, env, begin, iterations, step), body(env, lo, hi) runs a chunk
+  declareBuiltin("aurora_parallel_for",{i8p, i8p, i64, i64, i64}, voidTy, false)->setDoesNotThrow();
+  // channels move elements by address; try_* return nonzero on success
+  declareBuiltin("aurora_chan_new",{i64, i64, i32}, i8p, false)->setDoesNotThrow();
+  for (auto name : {"aurora_chan_send", "aurora_chan_recv"})
+    declareBuiltin(name,{i8p, i8p}, voidTy, false)->setDoesNotThrow();
+  for (auto name : {"aurora_chan_try_send", "aurora_chan_try_recv"})
+    declareBuiltin(name,{i8p, i8p}, i32, false)->setDoesNotThrow();
+  declareBuiltin("aurora_chan_free",{i8p}, voidTy, false)->setDoesNotThrow();
+  // spawn/join/sync: task frames come from the runtime and stay alive until the spawner returns
+  declareBuiltin("aurora_task_new",{i64, i8p, i8p}, i8p, false)->setDoesNotThrow();
+  for (auto name : {"aurora_spawn", "aurora_join", "aurora_sync", "aurora_scope_end"})
+    declareBuiltin(name,{i8p}, voidTy, false)->setDoesNotThrow();
 }
 
 CodeGen::~CodeGen() = default;  // Destructor definition
@@ -51,21 +120,685 @@ llvm::Type* CodeGen::tyLLVM(const ::Type& t){
     case TyKind::I64: return llvm::Type::getInt64Ty(*ctx);
     case TyKind::Bool: return llvm::Type::getInt1Ty(*ctx);
     case TyKind::Void: return llvm::Type::getVoidTy(*ctx);
-    case TyKind::Ptr:  return llvm::PointerType::getUnqual(tyLLVM(*t.elem));
-    case TyKind::Array: return llvm::ArrayType::get(tyLLVM(*t.elem), t.arraySize);
+    case TyKind::Ptr:  return llvm::PointerType::getUnqual(*ctx); // element type lives in ::Type
+    case TyKind::Array:
+      if (isSoa(*t.elem)){
+        // soa: { [N x field0], [N x field1], ... } in slot order
+        auto st = structType(t.elem->name);
+        std::vector<llvm::Type*> cols;
+        for (auto *ft : st->elements()) cols.push_back(llvm::ArrayType::get(ft, t.arraySize));
+        return llvm::StructType::get(*ctx, cols);
+      }
+      return llvm::ArrayType::get(tyLLVM(*t.elem), t.arraySize);
+    case TyKind::Struct: return structType(t.name);
+    case TyKind::Simd: return llvm::FixedVectorType::get(tyLLVM(*t.elem), t.arraySize);
+    case TyKind::Slice: return sliceType();
+    case TyKind::Vec: return vecType();
+    case TyKind::Future: return llvm::PointerType::getUnqual(*ctx); // task frame
+    case TyKind::Atomic: return tyLLVM(*t.elem); // only accessed through atomic instructions
+    case TyKind::Chan: return llvm::PointerType::getUnqual(*ctx); // runtime channel
+    case TyKind::Arena: return llvm::PointerType::getUnqual(*ctx); // runtime arena, see arenaType
   }
   return llvm::Type::getVoidTy(*ctx);
 }
 
+llvm::Constant* CodeGen::constLLVM(const ConstValue& v, const ::Type& t){
+  if (t.k==TyKind::Array){
+    std::vector<llvm::Constant*> elems;
+    for (auto& e : v.elems) elems.push_back(constLLVM(e, *t.elem));
+    return llvm::ConstantArray::get(llvm::cast<llvm::ArrayType>(tyLLVM(t)), elems);
+  }
+  return llvm::ConstantInt::get(tyLLVM(t), v.v, true);
+}
+
+void CodeGen::fillArray(llvm::Value* arr, llvm::Type* arrTy, llvm::Value* val){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  if (auto *c = llvm::dyn_cast<llvm::Constant>(val); c && c->isNullValue()){
+    B.CreateStore(llvm::ConstantAggregateZero::get(arrTy), arr); // lowered to memset
+    return;
+  }
+  if (auto *cols = llvm::dyn_cast<llvm::StructType>(arrTy)){
+    // soa array: fill each column with its field of val
+    for (unsigned k=0; k<cols->getNumElements(); ++k)
+      fillArray(B.CreateStructGEP(cols, arr, k), cols->getElementType(k), B.CreateExtractValue(val, k));
+    return;
+  }
+  // for (i = 0; i < n; ++i) arr[i] = val
+  auto i64 = indexType();
+  auto n = llvm::cast<llvm::ArrayType>(arrTy)->getNumElements();
+  auto TheFunction = B.GetInsertBlock()->getParent();
+  auto PreBB = B.GetInsertBlock();
+  auto LoopBB = llvm::BasicBlock::Create(*ctx, "fill.body", TheFunction);
+  auto EndBB = llvm::BasicBlock::Create(*ctx, "fill.end", TheFunction);
+  B.CreateBr(LoopBB);
+  B.SetInsertPoint(LoopBB);
+  auto i = B.CreatePHI(i64, 2, "fill.i");
+  i->addIncoming(llvm::ConstantInt::get(i64, 0), PreBB);
+  auto ptr = B.CreateInBoundsGEP(arrTy, arr, {llvm::ConstantInt::get(i64, 0), i});
+  B.CreateStore(val, ptr);
+  auto next = B.CreateAdd(i, llvm::ConstantInt::get(i64, 1), "fill.next", true, true);
+  i->addIncoming(next, LoopBB);
+  B.CreateCondBr(B.CreateICmpULT(next, llvm::ConstantInt::get(i64, n)), LoopBB, EndBB);
+  B.SetInsertPoint(EndBB);
+}
+
+llvm::StructType* CodeGen::structType(const std::string& name){
+  auto it = structTypes.find(name);
+  if (it!=structTypes.end()) return it->second;
+  auto& sd = *structDecls.at(name);
+  auto& DL = mod->getDataLayout();
+  std::vector<llvm::Type*> fieldTys;
+  for (auto& f : sd.fields) fieldTys.push_back(tyLLVM(*f.ty));
+  // most-aligned first leaves no interior padding; soa columns rely on it too
+  std::vector<unsigned> order(sd.fields.size());
+  for (unsigned k=0; k<order.size(); ++k) order[k] = k;
+  if (!sd.keepOrder)
+    std::stable_sort(order.begin(), order.end(), [&](unsigned a, unsigned b){
+      return DL.getABITypeAlign(fieldTys[a]).value() > DL.getABITypeAlign(fieldTys[b]).value();
+    });
+  auto& slots = fieldSlot[name];
+  slots.assign(sd.fields.size(), 0);
+  std::vector<llvm::Type*> body;
+  for (unsigned s=0; s<order.size(); ++s){ slots[order[s]] = s; body.push_back(fieldTys[order[s]]); }
+  auto st = llvm::StructType::create(*ctx, body, name);
+  structTypes[name] = st;
+  return st;
+}
+
+bool CodeGen::isSoa(const ::Type& elem){
+  return elem.k==TyKind::Struct && structDecls.at(elem.name)->soa;
+}
+
+uint64_t CodeGen::columnOffset(const std::string& name, unsigned slot){
+  auto st = structType(name);
+  uint64_t off = 0;
+  for (unsigned k=0; k<slot; ++k) off += mod->getDataLayout().getTypeAllocSize(st->getElementType(k));
+  return off;
+}
+
+// soa element a[i]: the container's address (array) or header (vec) and the index.
+CodeGen::SoaRef CodeGen::genSoaRef(EIndex& ix){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  SoaRef r{ix.arr->ty.get(), genAddr(*ix.arr), nullptr};
+  r.idx = B.CreateSExtOrTrunc(genExpr(*ix.idx), indexType(), "idx.ext");
+  return r;
+}
+
+// Column `slot` of a soa container at row r.idx. A vec keeps its columns back to back in one
+// buffer: column k starts at data + cap * (bytes per row of columns before k).
+llvm::Value* CodeGen::soaColumnAddr(const SoaRef& r, unsigned slot, llvm::Type*& colTy){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto& name = r.container->elem->name;
+  colTy = structType(name)->getElementType(slot);
+  if (r.container->k==TyKind::Array)
+    return B.CreateInBoundsGEP(tyLLVM(*r.container), r.base,
+      {llvm::ConstantInt::get(indexType(), 0), llvm::ConstantInt::get(llvm::Type::getInt32Ty(*ctx), slot), r.idx}, "soa.col");
+  auto data = B.CreateLoad(llvm::PointerType::getUnqual(*ctx), B.CreateStructGEP(vecType(), r.base, 0), "vec.data");
+  auto cap = B.CreateLoad(llvm::Type::getInt64Ty(*ctx), B.CreateStructGEP(vecType(), r.base, 2), "vec.cap");
+  auto col = B.CreateInBoundsGEP(B.getInt8Ty(), data, B.CreateNUWMul(cap, llvm::ConstantInt::get(cap->getType(), columnOffset(name, slot))));
+  return B.CreateInBoundsGEP(colTy, col, r.idx, "soa.col");
+}
+
+llvm::Value* CodeGen::genSoaLoad(const SoaRef& r){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto st = structType(r.container->elem->name);
+  llvm::Value* v = llvm::UndefValue::get(st);
+  for (unsigned k=0; k<st->getNumElements(); ++k){
+    llvm::Type* colTy;
+    auto addr = soaColumnAddr(r, k, colTy);
+    v = B.CreateInsertValue(v, B.CreateLoad(colTy, addr), k);
+  }
+  return v;
+}
+
+void CodeGen::genSoaStore(const SoaRef& r, llvm::Value* val){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto st = structType(r.container->elem->name);
+  for (unsigned k=0; k<st->getNumElements(); ++k){
+    llvm::Type* colTy;
+    auto addr = soaColumnAddr(r, k, colTy);
+    B.CreateStore(B.CreateExtractValue(val, k), addr);
+  }
+}
+
+// e is a[i] over a soa container: it has no address of its own, only columns.
+bool CodeGen::soaElement(Expr& e){
+  auto *ix = dynamic_cast<EIndex*>(&e);
+  auto k = ix ? ix->arr->ty->k : TyKind::Void;
+  return (k==TyKind::Array || k==TyKind::Vec) && isSoa(*ix->arr->ty->elem);
+}
+
+// Address of base.field; a field of a soa element is a column entry.
+llvm::Value* CodeGen::genFieldAddr(EField& f, llvm::Type*& fieldTy){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto& sname = f.base->ty->name;
+  auto st = structType(sname);
+  unsigned slot = fieldSlot[sname][f.index];
+  if (soaElement(*f.base))
+    return soaColumnAddr(genSoaRef(*static_cast<EIndex*>(f.base.get())), slot, fieldTy);
+  fieldTy = st->getElementType(slot);
+  return B.CreateStructGEP(st, genAddr(*f.base), slot, f.name);
+}
+
+// arr[i] = val for an array of type arrTy at arr (row-wise or soa).
+void CodeGen::storeElem(llvm::Value* arr, const ::Type& arrTy, uint64_t i, llvm::Value* val){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto idx = llvm::ConstantInt::get(indexType(), i);
+  if (isSoa(*arrTy.elem)){ genSoaStore(SoaRef{&arrTy, arr, idx}, val); return; }
+  auto elemTy = tyLLVM(*arrTy.elem);
+  if (elemTy->isAggregateType() && val->getType()->isPointerTy()) val = B.CreateLoad(elemTy, val);
+  B.CreateStore(val, B.CreateInBoundsGEP(tyLLVM(arrTy), arr, {llvm::ConstantInt::get(indexType(), 0), idx}));
+}
+
+// Address of an array-typed expression. Named, global and nested arrays are used in place;
+// array values without a home (e.g. returned by a call) are spilled to a temporary.
+llvm::Value* CodeGen::genAddr(Expr& e){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  if (auto *v = dynamic_cast<EVar*>(&e); v && namedValues.count(v->name)) return namedValues[v->name];
+  if (auto *ix = dynamic_cast<EIndex*>(&e); ix && !soaElement(e)){ llvm::Type* elemTy; return genIndexAddr(*ix, elemTy); }
+  if (auto *f = dynamic_cast<EField*>(&e)){ llvm::Type* fieldTy; return genFieldAddr(*f, fieldTy); }
+  auto val = genExpr(e);
+  if (val->getType()->isPointerTy()) return val;
+  auto tmp = entryAlloca(val->getType(), "arr.tmp");
+  B.CreateStore(val, tmp);
+  return tmp;
+}
+
+// Address of arr[idx]. Arrays are indexed in place, pointers and slices through their data
+// pointer. The index is sign-extended to the target's pointer-width index type.
+llvm::Value* CodeGen::genIndexAddr(EIndex& ix, llvm::Type*& elemTy){
+  return genElemAddr(*ix.arr, *ix.idx, elemTy);
+}
+
+llvm::Value* CodeGen::genElemAddr(Expr& arr, Expr& idx, llvm::Type*& elemTy){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto& baseTy = *arr.ty;
+  elemTy = tyLLVM(*baseTy.elem);
+  if (baseTy.k==TyKind::Array){
+    auto base = genAddr(arr);
+    auto index = B.CreateSExtOrTrunc(genExpr(idx), indexType(), "idx.ext");
+    return B.CreateInBoundsGEP(tyLLVM(baseTy), base, {llvm::ConstantInt::get(indexType(), 0), index}, "arrayidx");
+  }
+  llvm::Value* data;
+  if (baseTy.k==TyKind::Vec)
+    data = B.CreateLoad(llvm::PointerType::getUnqual(*ctx), B.CreateStructGEP(vecType(), genAddr(arr), 0), "vec.data");
+  else data = genExpr(arr);
+  if (baseTy.k==TyKind::Slice) data = B.CreateExtractValue(data, 0, "slice.ptr");
+  else if (baseTy.k!=TyKind::Ptr && baseTy.k!=TyKind::Vec) fatal("indexing requires array, slice, vec or pointer");
+  auto index = B.CreateSExtOrTrunc(genExpr(idx), indexType(), "idx.ext");
+  return B.CreateInBoundsGEP(elemTy, data, index, "ptridx");
+}
+
+// simd builtins; null when c is not one of them. Loads and stores touch N consecutive
+// elements at element alignment; reductions and shuffles map to single LLVM operations.
+llvm::Value* CodeGen::genSimdOp(ECall& c){
+  static const std::unordered_set<std::string> ops = {"simd", "splat", "load", "store", "shuffle", "select",
+    "reduce_add", "reduce_mul", "reduce_min", "reduce_max", "any", "all"};
+  if (!ops.count(c.callee) || userFuncs.count(c.callee)) return nullptr;
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto& DL = mod->getDataLayout();
+  if (c.callee=="simd" || c.callee=="splat" || c.callee=="load"){
+    auto& vt = *c.typeArgs[0];
+    auto vecTy = tyLLVM(vt);
+    if (c.callee=="load"){
+      llvm::Type* elemTy;
+      auto addr = genElemAddr(*c.args[0], *c.args[1], elemTy);
+      return B.CreateAlignedLoad(vecTy, addr, DL.getABITypeAlign(elemTy), "simd.load");
+    }
+    if (c.args.size()==1) return B.CreateVectorSplat(vt.arraySize, genExpr(*c.args[0]), "splat");
+    llvm::Value* v = llvm::PoisonValue::get(vecTy);
+    for (unsigned k=0; k<c.args.size(); ++k) v = B.CreateInsertElement(v, genExpr(*c.args[k]), k);
+    return v;
+  }
+  if (c.callee=="store"){
+    llvm::Type* elemTy;
+    auto addr = genElemAddr(*c.args[0], *c.args[1], elemTy);
+    return B.CreateAlignedStore(genExpr(*c.args[2]), addr, DL.getABITypeAlign(elemTy));
+  }
+  if (c.callee=="shuffle"){
+    auto a = genExpr(*c.args[0]);
+    auto b = c.args.size()==3 ? genExpr(*c.args[1]) : llvm::PoisonValue::get(a->getType());
+    std::vector<int> mask(c.imm.begin(), c.imm.end());
+    return B.CreateShuffleVector(a, b, mask, "shuffle");
+  }
+  if (c.callee=="select"){
+    auto m = genExpr(*c.args[0]);
+    auto a = genExpr(*c.args[1]);
+    return B.CreateSelect(m, a, genExpr(*c.args[2]), "select");
+  }
+  auto v = genExpr(*c.args[0]);
+  if (c.callee=="reduce_add") return B.CreateAddReduce(v);
+  if (c.callee=="reduce_mul") return B.CreateMulReduce(v);
+  if (c.callee=="reduce_min") return B.CreateIntMinReduce(v, /*signed*/true);
+  if (c.callee=="reduce_max") return B.CreateIntMaxReduce(v, /*signed*/true);
+  if (c.callee=="any") return B.CreateOrReduce(v);
+  return B.CreateAndReduce(v); // all
+}
+
+// Sema's MemOrder as an LLVM ordering.
+static llvm::AtomicOrdering llvmOrder(std::int64_t o){
+  switch ((MemOrder)o){
+    case MemOrder::Relaxed: return llvm::AtomicOrdering::Monotonic;
+    case MemOrder::Acquire: return llvm::AtomicOrdering::Acquire;
+    case MemOrder::Release: return llvm::AtomicOrdering::Release;
+    case MemOrder::AcqRel: return llvm::AtomicOrdering::AcquireRelease;
+    case MemOrder::SeqCst: break;
+  }
+  return llvm::AtomicOrdering::SequentiallyConsistent;
+}
+
+// Atomic builtins on the place named by the first argument, at the type's natural alignment;
+// null when c is not one of them. Sema has folded the orderings into c.imm.
+llvm::Value* CodeGen::genAtomicOp(ECall& c){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  if (c.callee=="atomic" && !c.typeArgs.empty() && !userFuncs.count("atomic"))
+    return genValueAs(*c.args[0], *c.typeArgs[0]);
+  if (c.args.empty() || !c.args[0]->ty || c.args[0]->ty->k!=TyKind::Atomic || userFuncs.count(c.callee)) return nullptr;
+  auto ty = tyLLVM(*c.args[0]->ty);
+  auto align = mod->getDataLayout().getABITypeAlign(ty);
+  auto addr = genAddr(*c.args[0]);
+  auto order = llvmOrder(c.imm[0]);
+  if (c.callee=="load"){
+    auto ld = B.CreateAlignedLoad(ty, addr, align, "atomic.load");
+    ld->setAtomic(order);
+    return ld;
+  }
+  auto val = genValueAs(*c.args[1], *c.args[0]->ty->elem);
+  if (c.callee=="store"){
+    auto st = B.CreateAlignedStore(val, addr, align);
+    st->setAtomic(order);
+    return st;
+  }
+  if (c.callee=="cas"){
+    auto desired = genValueAs(*c.args[2], *c.args[0]->ty->elem);
+    auto pair = B.CreateAtomicCmpXchg(addr, val, desired, align, order, llvmOrder(c.imm[1]));
+    return B.CreateExtractValue(pair, 1, "cas.ok");
+  }
+  static const std::unordered_map<std::string, llvm::AtomicRMWInst::BinOp> rmw = {
+    {"exchange", llvm::AtomicRMWInst::Xchg}, {"fetch_add", llvm::AtomicRMWInst::Add}, {"fetch_sub", llvm::AtomicRMWInst::Sub},
+    {"fetch_and", llvm::AtomicRMWInst::And}, {"fetch_or", llvm::AtomicRMWInst::Or}, {"fetch_xor", llvm::AtomicRMWInst::Xor},
+    {"fetch_min", llvm::AtomicRMWInst::Min}, {"fetch_max", llvm::AtomicRMWInst::Max}};
+  return B.CreateAtomicRMW(rmw.at(c.callee), addr, val, align, order);
+}
+
+// Channel builtins; null when c is not one of them. Elements travel through a stack slot
+// (send) or straight into the destination place (recv, try_recv).
+llvm::Value* CodeGen::genChanOp(ECall& c){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  if (userFuncs.count(c.callee)) return nullptr;
+  if ((c.callee=="chan" || c.callee=="spsc_chan") && !c.typeArgs.empty()){
+    auto esz = mod->getDataLayout().getTypeAllocSize(tyLLVM(*c.typeArgs[0]));
+    return B.CreateCall(mod->getFunction("aurora_chan_new"), {
+      llvm::ConstantInt::get(llvm::Type::getInt64Ty(*ctx), esz),
+      B.CreateSExt(genExpr(*c.args[0]), llvm::Type::getInt64Ty(*ctx)),
+      llvm::ConstantInt::get(llvm::Type::getInt32Ty(*ctx), c.callee=="spsc_chan")}, "chan");
+  }
+  if (c.args.empty() || !c.args[0]->ty || c.args[0]->ty->k!=TyKind::Chan) return nullptr;
+  auto ch = genExpr(*c.args[0]);
+  auto& elem = *c.args[0]->ty->elem;
+  if (c.callee=="free") return B.CreateCall(mod->getFunction("aurora_chan_free"), {ch});
+  if (c.callee=="send" || c.callee=="try_send"){
+    auto v = genValueAs(*c.args[1], elem);
+    auto ty = tyLLVM(elem);
+    if (ty->isAggregateType() && v->getType()->isPointerTy()) v = B.CreateLoad(ty, v);
+    auto slot = entryAlloca(ty, "chan.elem");
+    B.CreateStore(v, slot);
+    auto r = B.CreateCall(mod->getFunction("aurora_chan_"+c.callee), {ch, slot});
+    if (c.callee=="send") return r;
+    return B.CreateICmpNE(r, llvm::ConstantInt::get(r->getType(), 0), "sent");
+  }
+  if (c.callee=="try_recv"){
+    auto r = B.CreateCall(mod->getFunction("aurora_chan_try_recv"), {ch, genAddr(*c.args[1])});
+    return B.CreateICmpNE(r, llvm::ConstantInt::get(r->getType(), 0), "received");
+  }
+  auto slot = entryAlloca(tyLLVM(elem), "chan.elem");
+  B.CreateCall(mod->getFunction("aurora_chan_recv"), {ch, slot});
+  return B.CreateLoad(tyLLVM(elem), slot, "recv");
+}
+
+llvm::StructType* CodeGen::arenaType(){
+  return llvm::StructType::get(*ctx, {llvm::PointerType::getUnqual(*ctx), llvm::PointerType::getUnqual(*ctx)});
+}
+
+// Arena builtins; null when c is not one of them. arena_alloc is a pointer bump: align cur,
+// and if the request fits below end (kept 64-byte aligned by the runtime) advance cur past it.
+// Only a full chunk, alignment above 64, or a negative or overflowing count calls the runtime.
+llvm::Value* CodeGen::genArenaOp(ECall& c){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  if (userFuncs.count(c.callee) || c.callee.rfind("arena_", 0)!=0) return nullptr;
+  auto i64 = llvm::Type::getInt64Ty(*ctx);
+  auto ptrTy = llvm::PointerType::getUnqual(*ctx);
+  if (c.callee=="arena_new"){
+    llvm::Value* chunk = c.args.empty() ? llvm::ConstantInt::get(i64, 0) : B.CreateSExt(genExpr(*c.args[0]), i64);
+    return B.CreateCall(mod->getFunction("aurora_arena_new"), {chunk}, "arena");
+  }
+  auto a = genExpr(*c.args[0]);
+  if (c.callee=="arena_free") return B.CreateCall(mod->getFunction("aurora_arena_free"), {a});
+  if (c.callee=="arena_mark") return B.CreatePtrToInt(B.CreateLoad(ptrTy, a, "arena.cur"), i64, "arena.mark");
+  if (c.callee=="arena_reset"){
+    llvm::Value* mark = c.args.size()==2 ? B.CreateSExt(genExpr(*c.args[1]), i64) : llvm::ConstantInt::get(i64, 0);
+    return B.CreateCall(mod->getFunction("aurora_arena_reset"), {a, mark});
+  }
+  auto ty = tyLLVM(*c.typeArgs[0]);
+  auto& DL = mod->getDataLayout();
+  auto size = llvm::ConstantInt::get(i64, DL.getTypeAllocSize(ty));
+  uint64_t align = DL.getABITypeAlign(ty).value();
+  auto n = B.CreateSExt(genExpr(*c.args[1]), i64);
+  auto mul = B.CreateIntrinsic(llvm::Intrinsic::umul_with_overflow, {i64}, {n, size});
+  auto bytes = B.CreateExtractValue(mul, 0, "arena.bytes");
+  if (allocProfile) B.CreateCall(mod->getFunction("aurora_prof_note"), {bytes, llvm::ConstantInt::get(i64, c.line)});
+  auto grow = mod->getFunction("aurora_arena_grow");
+  auto slow = [&]{ return B.CreateCall(grow, {a, n, size, llvm::ConstantInt::get(i64, align)}, "arena.p"); };
+  if (align > 64) return slow();
+  auto F = B.GetInsertBlock()->getParent();
+  auto cur = B.CreateLoad(ptrTy, a, "arena.cur");
+  auto end = B.CreateLoad(ptrTy, B.CreateStructGEP(arenaType(), a, 1), "arena.end");
+  auto pad = B.CreateAnd(B.CreateNeg(B.CreatePtrToInt(cur, i64)), llvm::ConstantInt::get(i64, align-1), "arena.pad");
+  auto p = B.CreateGEP(B.getInt8Ty(), cur, pad, "arena.p");
+  auto avail = B.CreateSub(B.CreatePtrToInt(end, i64), B.CreatePtrToInt(p, i64), "arena.avail");
+  auto bumpBB = llvm::BasicBlock::Create(*ctx, "arena.bump", F);
+  auto growBB = llvm::BasicBlock::Create(*ctx, "arena.grow", F);
+  auto doneBB = llvm::BasicBlock::Create(*ctx, "arena.done", F);
+  // a negative count or an overflowing size takes the runtime path, which rejects it
+  auto bad = B.CreateOr(B.CreateExtractValue(mul, 1), B.CreateICmpSLT(n, llvm::ConstantInt::get(i64, 0)), "arena.bad");
+  auto fits = B.CreateAnd(B.CreateNot(bad), B.CreateICmpULE(bytes, avail), "arena.fits");
+  B.CreateCondBr(fits, bumpBB, growBB, llvm::MDBuilder(*ctx).createBranchWeights(2000, 1));
+  B.SetInsertPoint(bumpBB);
+  B.CreateStore(B.CreateGEP(B.getInt8Ty(), p, bytes, "arena.next"), a);
+  B.CreateBr(doneBB);
+  B.SetInsertPoint(growBB);
+  auto q = slow();
+  B.CreateBr(doneBB);
+  B.SetInsertPoint(doneBB);
+  auto r = B.CreatePHI(ptrTy, 2, "arena.alloc");
+  r->addIncoming(p, bumpBB);
+  r->addIncoming(q, growBB);
+  return r;
+}
+
+// pool_alloc<T>()/pool_free(p); null when c is not one of them. The size class is fixed here
+// from T's DataLayout size (16-byte steps up to 256), so both are inline operations on this
+// thread's list head: pop (refilling from a new slab when empty) and push.
+llvm::Value* CodeGen::genPoolOp(ECall& c){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  if (userFuncs.count(c.callee) || (c.callee!="pool_alloc" && c.callee!="pool_free")) return nullptr;
+  auto& elem = c.callee=="pool_alloc" ? *c.typeArgs[0] : *c.args[0]->ty->elem;
+  auto ty = tyLLVM(elem);
+  auto& DL = mod->getDataLayout();
+  uint64_t size = DL.getTypeAllocSize(ty);
+  if (size > 256 || DL.getABITypeAlign(ty).value() > 64)
+    fatal(c.callee+": "+elem.str()+" is "+std::to_string(size)+" bytes; pools hold types up to 256 bytes (use alloc<T>)");
+  uint64_t cls = size ? (size + 15) / 16 - 1 : 0;
+  auto ptrTy = llvm::PointerType::getUnqual(*ctx);
+  auto heads = mod->getNamedGlobal("aurora_pool_heads");
+  if (!heads)
+    heads = new llvm::GlobalVariable(*mod, llvm::ArrayType::get(ptrTy, 16), false, llvm::GlobalValue::ExternalLinkage,
+                                     nullptr, "aurora_pool_heads", nullptr, llvm::GlobalValue::InitialExecTLSModel);
+  auto headTy = llvm::ArrayType::get(ptrTy, 16);
+  auto slot = B.CreateConstInBoundsGEP2_64(headTy, heads, 0, cls, "pool.head.addr");
+  auto F = B.GetInsertBlock()->getParent();
+  if (c.callee=="pool_free"){
+    auto p = genExpr(*c.args[0]);
+    auto pushBB = llvm::BasicBlock::Create(*ctx, "pool.push", F);
+    auto doneBB = llvm::BasicBlock::Create(*ctx, "pool.done", F);
+    B.CreateCondBr(B.CreateIsNull(p), doneBB, pushBB); // pool_free of null does nothing
+    B.SetInsertPoint(pushBB);
+    B.CreateStore(B.CreateLoad(ptrTy, slot, "pool.head"), p);
+    auto st = B.CreateStore(p, slot);
+    B.CreateBr(doneBB);
+    B.SetInsertPoint(doneBB);
+    return st;
+  }
+  if (allocProfile)
+    B.CreateCall(mod->getFunction("aurora_prof_note"), {B.getInt64(size), B.getInt64(c.line)});
+  auto head = B.CreateLoad(ptrTy, slot, "pool.head");
+  auto popBB = llvm::BasicBlock::Create(*ctx, "pool.pop", F);
+  auto refillBB = llvm::BasicBlock::Create(*ctx, "pool.refill", F);
+  auto doneBB = llvm::BasicBlock::Create(*ctx, "pool.done", F);
+  B.CreateCondBr(B.CreateIsNull(head), refillBB, popBB, llvm::MDBuilder(*ctx).createBranchWeights(1, 2000));
+  B.SetInsertPoint(popBB);
+  B.CreateStore(B.CreateLoad(ptrTy, head, "pool.next"), slot);
+  B.CreateBr(doneBB);
+  B.SetInsertPoint(refillBB);
+  auto fresh = B.CreateCall(mod->getFunction("aurora_pool_refill"), {llvm::ConstantInt::get(llvm::Type::getInt64Ty(*ctx), cls)}, "pool.fresh");
+  B.CreateBr(doneBB);
+  B.SetInsertPoint(doneBB);
+  auto r = B.CreatePHI(ptrTy, 2, "pool.alloc");
+  r->addIncoming(head, popBB);
+  r->addIncoming(fresh, refillBB);
+  return r;
+}
+
+// File builtins; null when c is not one of them. Paths become private C strings and
+// the runtime gets element sizes, so it can check file and slice lengths in bytes.
+llvm::Value* CodeGen::genFileOp(ECall& c){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  if (userFuncs.count(c.callee)) return nullptr;
+  if (c.callee!="map_array" && c.callee!="unmap" && c.callee!="write_array_bin") return nullptr;
+  auto i64 = llvm::Type::getInt64Ty(*ctx);
+  auto size = [&](const ::Type& t){ return llvm::ConstantInt::get(i64, mod->getDataLayout().getTypeAllocSize(tyLLVM(t))); };
+  if (c.callee=="unmap"){
+    auto s = genExpr(*c.args[0]);
+    return B.CreateCall(mod->getFunction("aurora_unmap"), {B.CreateExtractValue(s, 0), B.CreateExtractValue(s, 1), size(*c.args[0]->ty->elem)});
+  }
+  auto path = B.CreateGlobalString(static_cast<EStr&>(*c.args[0]).v, "path");
+  if (c.callee=="write_array_bin"){
+    auto& elem = *c.args[1]->ty->elem;
+    auto s = genValueAs(*c.args[1], *::Type::slice(elem.clone()));
+    return B.CreateCall(mod->getFunction("aurora_write_file"), {path, B.CreateExtractValue(s, 0, "data"),
+      B.CreateExtractValue(s, 1, "len"), B.CreateSExt(genExpr(*c.args[2]), i64), size(elem)});
+  }
+  auto count = entryAlloca(i64, "map.len");
+  auto data = B.CreateCall(mod->getFunction("aurora_map_file"), {path, size(*c.typeArgs[0]), llvm::ConstantInt::get(i64, c.imm[0]), count}, "map.data");
+  llvm::Value* s = llvm::UndefValue::get(sliceType());
+  s = B.CreateInsertValue(s, data, 0);
+  return B.CreateInsertValue(s, B.CreateLoad(i64, count, "map.len"), 1);
+}
+
+// Value of e converted to type `to`: fixed arrays become slices {data, N}, vecs {data, len}.
+llvm::Value* CodeGen::genValueAs(Expr& e, const ::Type& to){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  if (to.k==TyKind::Slice && e.ty->k==TyKind::Vec){
+    auto hdr = genAddr(e);
+    llvm::Value* s = llvm::UndefValue::get(sliceType());
+    s = B.CreateInsertValue(s, B.CreateLoad(llvm::PointerType::getUnqual(*ctx), B.CreateStructGEP(vecType(), hdr, 0), "vec.data"), 0);
+    s = B.CreateInsertValue(s, B.CreateLoad(llvm::Type::getInt64Ty(*ctx), B.CreateStructGEP(vecType(), hdr, 1), "vec.len"), 1);
+    return s;
+  }
+  if (to.k==TyKind::Slice && e.ty->k==TyKind::Array){
+    llvm::Value* s = llvm::UndefValue::get(sliceType());
+    s = B.CreateInsertValue(s, genRefAddr(e), 0);
+    s = B.CreateInsertValue(s, llvm::ConstantInt::get(llvm::Type::getInt64Ty(*ctx), e.ty->arraySize), 1);
+    return s;
+  }
+  return genExpr(e);
+}
+
+// Address handed out as a reference (array parameter, slice data). Read-only constant
+// tables are copied so the callee may write through the reference.
+llvm::Value* CodeGen::genRefAddr(Expr& e){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto addr = genAddr(e);
+  if (auto *GV = llvm::dyn_cast<llvm::GlobalVariable>(addr); GV && GV->isConstant()){
+    auto tmp = entryAlloca(GV->getValueType(), GV->getName()+".copy");
+    B.CreateStore(B.CreateLoad(GV->getValueType(), GV), tmp);
+    return tmp;
+  }
+  return addr;
+}
+
+llvm::StructType* CodeGen::sliceType(){
+  return llvm::StructType::get(*ctx, {llvm::PointerType::getUnqual(*ctx), llvm::Type::getInt64Ty(*ctx)});
+}
+
+llvm::StructType* CodeGen::vecType(){
+  auto i64 = llvm::Type::getInt64Ty(*ctx);
+  return llvm::StructType::get(*ctx, {llvm::PointerType::getUnqual(*ctx), i64, i64});
+}
+
+// Bytes per element; a soa row is the sum of its columns (no padding between fields).
+uint64_t CodeGen::vecRowBytes(const ::Type& vt){
+  if (isSoa(*vt.elem)) return columnOffset(vt.elem->name, structType(vt.elem->name)->getNumElements());
+  return mod->getDataLayout().getTypeAllocSize(tyLLVM(*vt.elem));
+}
+
+// Ensure capacity for `need` elements. soa vecs pass their column sizes so the runtime can
+// move each column to its place in the larger buffer.
+llvm::Value* CodeGen::genVecGrow(const ::Type& vt, llvm::Value* hdr, llvm::Value* need){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto i64 = llvm::Type::getInt64Ty(*ctx);
+  if (!isSoa(*vt.elem))
+    return B.CreateCall(mod->getFunction("aurora_vec_grow"), {hdr, llvm::ConstantInt::get(i64, vecRowBytes(vt)), need});
+  auto& name = vt.elem->name;
+  auto st = structType(name);
+  auto colsName = "soa.cols."+name;
+  auto cols = mod->getNamedGlobal(colsName);
+  if (!cols){
+    std::vector<llvm::Constant*> sizes;
+    for (auto *ft : st->elements()) sizes.push_back(llvm::ConstantInt::get(i64, mod->getDataLayout().getTypeAllocSize(ft)));
+    auto init = llvm::ConstantArray::get(llvm::ArrayType::get(i64, sizes.size()), sizes);
+    cols = new llvm::GlobalVariable(*mod, init->getType(), true, llvm::GlobalValue::PrivateLinkage, init, colsName);
+    cols->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+  }
+  return B.CreateCall(mod->getFunction("aurora_vec_grow_soa"), {hdr, cols, llvm::ConstantInt::get(i64, st->getNumElements()), need});
+}
+
+// push/pop/reserve/free on the vec header at genAddr(arg 0). push keeps the common case
+// inline (compare len with cap, store, bump len); only a full buffer calls the runtime.
+llvm::Value* CodeGen::genVecOp(ECall& c){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto& vt = *c.args[0]->ty;
+  auto i64 = llvm::Type::getInt64Ty(*ctx);
+  auto elemTy = tyLLVM(*vt.elem);
+  auto esz = llvm::ConstantInt::get(i64, vecRowBytes(vt));
+  bool soa = isSoa(*vt.elem);
+  auto hdr = genAddr(*c.args[0]);
+  auto F = B.GetInsertBlock()->getParent();
+  if (c.callee=="free") return B.CreateCall(mod->getFunction("aurora_vec_free"), {hdr, esz});
+  if (c.callee=="reserve") return genVecGrow(vt, hdr, B.CreateSExt(genExpr(*c.args[1]), i64)); // no-op when cap suffices
+  auto lenAddr = B.CreateStructGEP(vecType(), hdr, 1, "vec.len.addr");
+  if (c.callee=="push"){
+    auto val = genValueAs(*c.args[1], *vt.elem);
+    if (elemTy->isAggregateType() && val->getType()->isPointerTy()) val = B.CreateLoad(elemTy, val);
+    auto len = B.CreateLoad(i64, lenAddr, "vec.len");
+    auto cap = B.CreateLoad(i64, B.CreateStructGEP(vecType(), hdr, 2), "vec.cap");
+    auto growBB = llvm::BasicBlock::Create(*ctx, "push.grow", F);
+    auto storeBB = llvm::BasicBlock::Create(*ctx, "push.store", F);
+    B.CreateCondBr(B.CreateICmpULT(len, cap), storeBB, growBB, llvm::MDBuilder(*ctx).createBranchWeights(2000, 1));
+    B.SetInsertPoint(growBB);
+    genVecGrow(vt, hdr, B.CreateAdd(len, llvm::ConstantInt::get(i64, 1)));
+    B.CreateBr(storeBB);
+    B.SetInsertPoint(storeBB);
+    if (soa) genSoaStore(SoaRef{&vt, hdr, len}, val);
+    else {
+      auto data = B.CreateLoad(llvm::PointerType::getUnqual(*ctx), B.CreateStructGEP(vecType(), hdr, 0), "vec.data");
+      B.CreateStore(val, B.CreateInBoundsGEP(elemTy, data, len, "push.slot"));
+    }
+    return B.CreateStore(B.CreateNUWAdd(len, llvm::ConstantInt::get(i64, 1)), lenAddr);
+  }
+  // pop: the last element; popping an empty vec aborts in the runtime
+  auto len = B.CreateLoad(i64, lenAddr, "vec.len");
+  auto emptyBB = llvm::BasicBlock::Create(*ctx, "pop.empty", F);
+  auto okBB = llvm::BasicBlock::Create(*ctx, "pop.ok", F);
+  B.CreateCondBr(B.CreateICmpEQ(len, llvm::ConstantInt::get(i64, 0)), emptyBB, okBB, llvm::MDBuilder(*ctx).createBranchWeights(1, 2000));
+  B.SetInsertPoint(emptyBB);
+  B.CreateCall(mod->getFunction("aurora_vec_pop_empty"));
+  B.CreateUnreachable();
+  B.SetInsertPoint(okBB);
+  auto last = B.CreateNUWSub(len, llvm::ConstantInt::get(i64, 1));
+  B.CreateStore(last, lenAddr);
+  if (soa) return genSoaLoad(SoaRef{&vt, hdr, last});
+  auto data = B.CreateLoad(llvm::PointerType::getUnqual(*ctx), B.CreateStructGEP(vecType(), hdr, 0), "vec.data");
+  return B.CreateLoad(elemTy, B.CreateInBoundsGEP(elemTy, data, last), "pop");
+}
+
+// Locals live in the entry block so mem2reg can promote them and a `let` inside a loop
+// reuses one slot instead of growing the stack every iteration.
+llvm::AllocaInst* CodeGen::entryAlloca(llvm::Type* ty, const llvm::Twine& name){
+  auto& entry = builder->GetInsertBlock()->getParent()->getEntryBlock();
+  llvm::IRBuilder<> tmp(&entry, entry.getFirstInsertionPt());
+  return tmp.CreateAlloca(ty, nullptr, name);
+}
+
+// Arguments as the callee's LLVM signature takes them (see the parameter lowering in emit).
+std::vector<llvm::Value*> CodeGen::genCallArgs(ECall& c){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto fi = userFuncs.find(c.callee);
+  std::vector<llvm::Value*> argv;
+  for (size_t k=0; k<c.args.size(); ++k){
+    auto& a = *c.args[k];
+    if (fi==userFuncs.end()){ argv.push_back(genExpr(a)); continue; }
+    auto& pt = *fi->second->params[k].ty;
+    if (pt.k==TyKind::Array){ argv.push_back(genRefAddr(a)); continue; } // by reference
+    if (pt.k==TyKind::Vec){ argv.push_back(genAddr(a)); continue; }       // header by reference
+    if (pt.k==TyKind::Slice){
+      // slices travel as two scalar arguments so each can carry its own attributes
+      auto s = genValueAs(a, pt);
+      argv.push_back(B.CreateExtractValue(s, 0, "slice.ptr"));
+      argv.push_back(B.CreateExtractValue(s, 1, "slice.len"));
+      continue;
+    }
+    argv.push_back(genExpr(a));
+  }
+  return argv;
+}
+
+// The runtime owns the first four words: run function, next task and scope of the spawner, state.
+llvm::StructType* CodeGen::taskFrame(const std::string& callee){
+  auto F = functions.at(callee);
+  std::vector<llvm::Type*> fields{llvm::ArrayType::get(llvm::PointerType::getUnqual(*ctx), 4)};
+  if (!F->getReturnType()->isVoidTy()) fields.push_back(F->getReturnType());
+  for (auto& arg : F->args()) fields.push_back(arg.getType());
+  return llvm::StructType::get(*ctx, fields);
+}
+
+llvm::Function* CodeGen::spawnThunk(const std::string& callee){
+  if (auto it = spawnThunks.find(callee); it!=spawnThunks.end()) return it->second;
+  auto F = functions.at(callee);
+  auto frameTy = taskFrame(callee);
+  auto FT = llvm::FunctionType::get(llvm::Type::getVoidTy(*ctx), {llvm::PointerType::getUnqual(*ctx)}, false);
+  auto T = llvm::Function::Create(FT, llvm::Function::InternalLinkage, callee+".task", mod.get());
+  T->setDoesNotThrow();
+  llvm::IRBuilder<> tb(llvm::BasicBlock::Create(*ctx, "entry", T));
+  bool hasResult = !F->getReturnType()->isVoidTy();
+  std::vector<llvm::Value*> argv;
+  for (auto& arg : F->args())
+    argv.push_back(tb.CreateLoad(arg.getType(), tb.CreateStructGEP(frameTy, T->getArg(0), (hasResult ? 2 : 1) + arg.getArgNo())));
+  auto call = tb.CreateCall(F, argv);
+  call->setCallingConv(F->getCallingConv());
+  if (hasResult) tb.CreateStore(call, tb.CreateStructGEP(frameTy, T->getArg(0), 1));
+  tb.CreateRetVoid();
+  spawnThunks[callee] = T;
+  return T;
+}
+
+void CodeGen::endSpawnScope(){
+  if (spawnScope) builder->CreateCall(mod->getFunction("aurora_scope_end"), {spawnScope});
+}
+
+llvm::IntegerType* CodeGen::indexType(){
+  return llvm::cast<llvm::IntegerType>(mod->getDataLayout().getIndexType(llvm::PointerType::getUnqual(*ctx)));
+}
+
 llvm::Value* CodeGen::genExpr(Expr& e){
   auto& B = *static_cast<BuilderWrap*>(builder.get());
-  if (auto *x = dynamic_cast<EInt*>(&e)) return llvm::ConstantInt::get(llvm::Type::getInt64Ty(*ctx), x->v, true);
+  if (auto *x = dynamic_cast<EInt*>(&e)) return llvm::ConstantInt::get(x->ty ? tyLLVM(*x->ty) : llvm::Type::getInt64Ty(*ctx), x->v, true);
   if (auto *b = dynamic_cast<EBool*>(&e)) return llvm::ConstantInt::get(llvm::Type::getInt1Ty(*ctx), b->v);
   if (auto *v = dynamic_cast<EVar*>(&e)){
-    auto it = namedValues.find(v->name); if (it==namedValues.end()) fatal("unknown var: "+v->name);
+    if (auto iv = inductionVars.find(v->name); iv!=inductionVars.end()) return iv->second;
+    auto it = namedValues.find(v->name);
+    if (it==namedValues.end()){
+      auto ci = constValues.find(v->name);
+      if (ci!=constValues.end()){
+        auto want = v->ty ? tyLLVM(*v->ty) : ci->second->getType();
+        if (want==ci->second->getType()) return ci->second;
+        return llvm::ConstantInt::get(want, llvm::cast<llvm::ConstantInt>(ci->second)->getSExtValue(), true);
+      }
+      fatal("unknown var: "+v->name);
+    }
     auto typeIt = namedTypes.find(v->name); if (typeIt==namedTypes.end()) fatal("unknown var type: "+v->name);
     // Arrays should never be loaded as values - always return the pointer
-    if (typeIt->second->isArrayTy()) {
+    if (typeIt->second->isArrayTy() || v->ty->k==TyKind::Array) {
       return it->second;  // Return alloca pointer
     }
     // For non-arrays, load the value
@@ -83,56 +816,63 @@ llvm::Value* CodeGen::genExpr(Expr& e){
   if (auto *bin = dynamic_cast<EBin*>(&e)){
     if (bin->op==TokKind::Eq){
       // Check if LHS is array/pointer indexing
+        if (auto *idx = dynamic_cast<EIndex*>(bin->lhs.get()); idx && idx->arr->ty->k==TyKind::Simd){
+        // lane write: read-modify-write of the whole vector
+        auto addr = genAddr(*idx->arr);
+        auto vecTy = tyLLVM(*idx->arr->ty);
+        auto lane = genExpr(*idx->idx);
+        auto rv = genExpr(*bin->rhs);
+        B.CreateStore(B.CreateInsertElement(B.CreateLoad(vecTy, addr), rv, lane), addr);
+        return rv;
+      }
+      if (soaElement(*bin->lhs)){
+        auto r = genSoaRef(*static_cast<EIndex*>(bin->lhs.get()));
+        auto rv = genExpr(*bin->rhs);
+        if (rv->getType()->isPointerTy()) rv = B.CreateLoad(structType(bin->lhs->ty->name), rv);
+        genSoaStore(r, rv);
+        return rv;
+      }
+      if (auto *f = dynamic_cast<EField*>(bin->lhs.get())){
+        llvm::Type* fieldTy;
+        auto ptr = genFieldAddr(*f, fieldTy);
+        auto rv = genValueAs(*bin->rhs, *f->ty);
+        if (fieldTy->isAggregateType() && rv->getType()->isPointerTy()) rv = B.CreateLoad(fieldTy, rv);
+        B.CreateStore(rv, ptr);
+        return rv;
+      }
       if (auto *idx = dynamic_cast<EIndex*>(bin->lhs.get())){
-        auto arrVar = dynamic_cast<EVar*>(idx->arr.get());
-        if (!arrVar) fatal("array/pointer indexing on non-variable");
-        
-        auto it = namedValues.find(arrVar->name);
-        if (it == namedValues.end()) fatal("unknown array/pointer variable in assignment");
-        
-        auto typeIt = namedTypes.find(arrVar->name);
-        if (typeIt == namedTypes.end()) fatal("unknown array/pointer type");
-        
-        auto arrPtr = it->second;  // Pointer to array or pointer value
-        auto index = genExpr(*idx->idx);
-        
-        // Convert index to i32 if needed
-        if (index->getType() != llvm::Type::getInt32Ty(*ctx)) {
-          index = B.CreateTrunc(index, llvm::Type::getInt32Ty(*ctx));
-        }
-        
-        llvm::Value* ptr;
         llvm::Type* elemType;
-        
-        if (typeIt->second->isArrayTy()) {
-          // Array case: need to index with [0, index]
-          auto zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*ctx), 0);
-          auto arrayType = llvm::cast<llvm::ArrayType>(typeIt->second);
-          elemType = arrayType->getElementType();
-          ptr = B.CreateInBoundsGEP(typeIt->second, arrPtr, {zero, index});
-        } else {
-          // Pointer case: need to load the pointer value first, then index
-          // For now assume i64 elements
-          elemType = llvm::Type::getInt64Ty(*ctx);
-          auto ptrValue = B.CreateLoad(llvm::PointerType::getUnqual(*ctx), arrPtr, "ptr_load");
-          ptr = B.CreateInBoundsGEP(elemType, ptrValue, index);
-        }
-        
-        auto rv = genExpr(*bin->rhs);
-        auto store = B.CreateStore(rv, ptr);
-        store->setAlignment(llvm::Align(8)); // 8-byte alignment
+        auto ptr = genIndexAddr(*idx, elemType);
+        auto rv = genValueAs(*bin->rhs, *idx->ty);
+        if (elemType->isAggregateType() && rv->getType()->isPointerTy()) rv = B.CreateLoad(elemType, rv);
+        B.CreateStore(rv, ptr);
         return rv;
       }
       
       auto lhs = dynamic_cast<EVar*>(bin->lhs.get());
       if (!lhs) fatal("assignment target must be a variable");
       auto it = namedValues.find(lhs->name); if (it==namedValues.end()) fatal("unknown var in assign");
-      auto rv = genExpr(*bin->rhs);
+      auto rv = genValueAs(*bin->rhs, *lhs->ty);
+      if ((lhs->ty->k==TyKind::Array || lhs->ty->k==TyKind::Struct) && rv->getType()->isPointerTy()) rv = B.CreateLoad(tyLLVM(*lhs->ty), rv);
       B.CreateStore(rv, it->second);
       return rv;
     }
     auto a = genExpr(*bin->lhs);
     auto b = genExpr(*bin->rhs);
+    // simd with a scalar operand: broadcast the scalar to every lane
+    if (a->getType()->isVectorTy() != b->getType()->isVectorTy()){
+      auto n = llvm::cast<llvm::FixedVectorType>((a->getType()->isVectorTy() ? a : b)->getType())->getNumElements();
+      if (a->getType()->isVectorTy()) b = B.CreateVectorSplat(n, b); else a = B.CreateVectorSplat(n, a);
+    }
+    // mixed widths (i32 with i64, bool in arithmetic): widen the narrower operand
+    if (a->getType()!=b->getType() && a->getType()->isIntegerTy() && b->getType()->isIntegerTy()){
+      auto wide = a->getType()->getIntegerBitWidth() > b->getType()->getIntegerBitWidth() ? a->getType() : b->getType();
+      auto widen = [&](llvm::Value* v){
+        if (v->getType()==wide) return v;
+        return v->getType()->isIntegerTy(1) ? B.CreateZExt(v, wide) : B.CreateSExt(v, wide);
+      };
+      a = widen(a); b = widen(b);
+    }
     switch (bin->op){
       case TokKind::Plus: return B.CreateAdd(a,b);
       case TokKind::Minus: return B.CreateSub(a,b);
@@ -152,104 +892,244 @@ llvm::Value* CodeGen::genExpr(Expr& e){
     fatal("binary op");
   }
   if (auto *c = dynamic_cast<ECall*>(&e)){
+    if (c->callee=="alloc" || ((c->callee=="alloc_zeroed" || c->callee=="alloc_large") && !userFuncs.count(c->callee))){
+      auto elemTy = tyLLVM(*c->typeArgs[0]);
+      auto n = B.CreateSExtOrTrunc(genExpr(*c->args[0]), indexType());
+      auto size = llvm::ConstantInt::get(indexType(), mod->getDataLayout().getTypeAllocSize(elemTy));
+      auto line = B.getInt64(c->line);
+      if (c->callee=="alloc_large"){
+        auto huge = c->args.size()>1 ? B.CreateZExt(genExpr(*c->args[1]), B.getInt32Ty()) : B.getInt32(1);
+        std::vector<llvm::Value*> argv{B.CreateSExt(n, B.getInt64Ty()), B.CreateSExt(size, B.getInt64Ty()), huge};
+        if (allocProfile) argv.push_back(line);
+        return B.CreateCall(mod->getFunction(allocProfile ? "aurora_prof_alloc_large" : "aurora_alloc_large"), argv, "alloc");
+      }
+      if (c->callee=="alloc_zeroed" || c==zeroedAlloc){
+        if (allocProfile) return B.CreateCall(mod->getFunction("aurora_prof_calloc"), {B.CreateSExt(n, B.getInt64Ty()), B.CreateSExt(size, B.getInt64Ty()), line}, "alloc");
+        return B.CreateCall(mod->getFunction("calloc"), {n, size}, "alloc");
+      }
+      // a negative count or an overflowing size asks for SIZE_MAX bytes, which malloc refuses
+      auto mul = B.CreateIntrinsic(llvm::Intrinsic::umul_with_overflow, {indexType()}, {n, size});
+      auto bad = B.CreateOr(B.CreateExtractValue(mul, 1), B.CreateICmpSLT(n, llvm::ConstantInt::get(indexType(), 0)), "alloc.bad");
+      auto bytes = B.CreateSelect(bad, llvm::Constant::getAllOnesValue(indexType()), B.CreateExtractValue(mul, 0), "alloc.bytes");
+      if (allocProfile) return B.CreateCall(mod->getFunction("aurora_prof_malloc"), {B.CreateSExt(bytes, B.getInt64Ty()), line}, "alloc");
+      return B.CreateCall(mod->getFunction("malloc"), {bytes}, "alloc");
+    }
+    if (c->callee=="free_large" && !userFuncs.count(c->callee))
+      return B.CreateCall(mod->getFunction(allocProfile ? "aurora_prof_free_large" : "aurora_free_large"), {genExpr(*c->args[0])});
+    if (c->callee=="vec"){
+      llvm::Value* v = llvm::Constant::getNullValue(vecType());
+      if (c->args.empty()) return v;
+      auto tmp = entryAlloca(vecType(), "vec.tmp");
+      B.CreateStore(v, tmp);
+      genVecGrow(*c->ty, tmp, B.CreateSExt(genExpr(*c->args[0]), llvm::Type::getInt64Ty(*ctx)));
+      return B.CreateLoad(vecType(), tmp);
+    }
+    if (auto v = genAtomicOp(*c)) return v;
+    if (auto v = genChanOp(*c)) return v;
+    if (auto v = genSimdOp(*c)) return v;
+    if (auto v = genArenaOp(*c)) return v;
+    if (auto v = genPoolOp(*c)) return v;
+    if (auto v = genFileOp(*c)) return v;
+    bool builtin = !userFuncs.count(c->callee);
+    if (builtin && !c->args.empty() && c->args[0]->ty->k==TyKind::Vec &&
+        (c->callee=="push" || c->callee=="pop" || c->callee=="reserve" || c->callee=="free"))
+      return genVecOp(*c);
+    if (builtin && c->callee=="len"){
+      auto& t = *c->args[0]->ty;
+      if (t.k==TyKind::Array) return llvm::ConstantInt::get(llvm::Type::getInt64Ty(*ctx), t.arraySize);
+      if (t.k==TyKind::Vec)
+        return B.CreateLoad(llvm::Type::getInt64Ty(*ctx), B.CreateStructGEP(vecType(), genAddr(*c->args[0]), 1), "len");
+      return B.CreateExtractValue(genExpr(*c->args[0]), 1, "len");
+    }
+    if (builtin && (c->callee=="read_array_i64" || c->callee=="print_array_i64")){
+      auto i64 = llvm::Type::getInt64Ty(*ctx);
+      auto s = genValueAs(*c->args[0], *Type::slice(Type::i64()));
+      std::vector<llvm::Value*> argv{B.CreateExtractValue(s, 0, "data"), B.CreateExtractValue(s, 1, "len")};
+      for (size_t k=1; k<c->args.size(); ++k) argv.push_back(B.CreateSExt(genExpr(*c->args[k]), i64));
+      return B.CreateCall(mod->getFunction("aurora_"+c->callee), argv);
+    }
+    if (builtin && c->callee=="slice"){
+      llvm::Value* s = llvm::UndefValue::get(sliceType());
+      s = B.CreateInsertValue(s, genExpr(*c->args[0]), 0);
+      s = B.CreateInsertValue(s, B.CreateSExt(genExpr(*c->args[1]), llvm::Type::getInt64Ty(*ctx)), 1);
+      return s;
+    }
+    if (builtin && c->callee=="join"){
+      auto task = genExpr(*c->args[0]);
+      auto wait = B.CreateCall(mod->getFunction("aurora_join"), {task});
+      if (c->ty->k==TyKind::Void) return wait;
+      auto resTy = tyLLVM(*c->ty);
+      auto frame = llvm::StructType::get(*ctx, {llvm::ArrayType::get(llvm::PointerType::getUnqual(*ctx), 4), resTy});
+      return B.CreateLoad(resTy, B.CreateStructGEP(frame, task, 1), "joined");
+    }
+    if (builtin && allocProfile && c->callee=="malloc")
+      return B.CreateCall(mod->getFunction("aurora_prof_malloc"), {genExpr(*c->args[0]), B.getInt64(c->line)}, "alloc");
+    if (builtin && allocProfile && c->callee=="free")
+      return B.CreateCall(mod->getFunction("aurora_prof_free"), {genExpr(*c->args[0])});
     auto F = mod->getFunction(c->callee);
     if (!F) fatal("unknown callee: "+c->callee);
-    std::vector<llvm::Value*> argv;
-    for (auto& a : c->args) argv.push_back(genExpr(*a));
-    return builder->CreateCall(F, argv, c->callee=="print_i64"?"print_ret":"");
+    auto argv = genCallArgs(*c);
+    auto call = builder->CreateCall(F, argv, c->callee=="print_i64"?"print_ret":"");
+    call->setCallingConv(F->getCallingConv());
+    return call;
+  }
+  if (auto *sp = dynamic_cast<ESpawn*>(&e)){
+    auto& c = static_cast<ECall&>(*sp->call);
+    auto argv = genCallArgs(c);
+    auto frameTy = taskFrame(c.callee);
+    auto size = llvm::ConstantInt::get(llvm::Type::getInt64Ty(*ctx), mod->getDataLayout().getTypeAllocSize(frameTy));
+    auto task = B.CreateCall(mod->getFunction("aurora_task_new"), {size, spawnThunk(c.callee), spawnScope}, "task");
+    unsigned base = c.ty->k==TyKind::Void ? 1 : 2;
+    for (size_t k=0; k<argv.size(); ++k) B.CreateStore(argv[k], B.CreateStructGEP(frameTy, task, base+(unsigned)k));
+    B.CreateCall(mod->getFunction("aurora_spawn"), {task});
+    return task;
   }
   if (auto *a = dynamic_cast<EArrayLit*>(&e)){
     // Arrays are stack allocated - create alloca and initialize
     if (a->elems.empty()) fatal("empty array literal");
-    auto elemType = genExpr(*a->elems[0])->getType();
-    auto arrayType = llvm::ArrayType::get(elemType, a->elems.size());
-    auto alloca = B.CreateAlloca(arrayType, nullptr, "array_lit");
-    
-    // Initialize array elements
-    for (size_t i = 0; i < a->elems.size(); ++i){
-      auto idx = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*ctx), i);
-      auto zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*ctx), 0);
-      auto ptr = B.CreateInBoundsGEP(arrayType, alloca, {zero, idx});
-      auto store = B.CreateStore(genExpr(*a->elems[i]), ptr);
-      store->setAlignment(llvm::Align(8)); // 8-byte alignment
-    }
+    auto alloca = entryAlloca(tyLLVM(*a->ty), "array_lit");
+    for (size_t i = 0; i < a->elems.size(); ++i) storeElem(alloca, *a->ty, i, genExpr(*a->elems[i]));
     return alloca;
   }
-  if (auto *idx = dynamic_cast<EIndex*>(&e)){
-    // Get the array/pointer expression - this should return a pointer
-    llvm::Value* arrExpr = genExpr(*idx->arr);
-    
-    // The result of genExpr for an array or pointer should be a pointer
-    if (!arrExpr->getType()->isPointerTy()) {
-      fatal("array/pointer expression must be a pointer");
-    }
-    
-    // For LLVM 15+, we need to track the pointee type separately
-    // since opaque pointers don't carry type information
-    llvm::Type* pointeeType = nullptr;
-    bool isArrayType = false;
-    
-    // If the expression is a variable, get its type from our map
-    if (auto *arrVar = dynamic_cast<EVar*>(idx->arr.get())) {
-      auto typeIt = namedTypes.find(arrVar->name);
-      if (typeIt != namedTypes.end()) {
-        if (typeIt->second->isArrayTy()) {
-          pointeeType = typeIt->second;
-          isArrayType = true;
-        } else if (typeIt->second->isPointerTy()) {
-          // For pointer types, the pointee is what we're pointing to
-          // We need to track this separately - for now use i64 as default
-          pointeeType = llvm::Type::getInt64Ty(*ctx);
-          isArrayType = false;
-        }
-      }
-    }
-    
-    if (!pointeeType) {
-      // Default to i64 for pointer indexing if we can't determine the type
-      pointeeType = llvm::Type::getInt64Ty(*ctx);
-      isArrayType = false;
+  if (auto *rep = dynamic_cast<EArrayRepeat*>(&e)){
+    auto val = genExpr(*rep->value);
+    auto arrayType = tyLLVM(*rep->ty);
+    auto alloca = entryAlloca(arrayType, "array_rep");
+    fillArray(alloca, arrayType, val);
+    return alloca;
+  }
+  if (auto *lit = dynamic_cast<EStruct*>(&e)){
+    // omitted fields stay zero
+    auto st = structType(lit->name);
+    auto& sd = *structDecls.at(lit->name);
+    llvm::Value* v = llvm::Constant::getNullValue(st);
+    for (auto& [name, init] : lit->inits){
+      unsigned k = 0;
+      while (sd.fields[k].name!=name) ++k;
+      unsigned slot = fieldSlot[lit->name][k];
+      auto fv = genValueAs(*init, *sd.fields[k].ty);
+      if (st->getElementType(slot)->isAggregateType() && fv->getType()->isPointerTy()) fv = B.CreateLoad(st->getElementType(slot), fv);
+      v = B.CreateInsertValue(v, fv, slot);
     }
-    
+    return v;
+  }
+  if (auto *f = dynamic_cast<EField*>(&e)){
+    llvm::Type* fieldTy;
+    auto addr = genFieldAddr(*f, fieldTy);
+    if (f->ty->k==TyKind::Array) return addr; // arrays are used by address
+    return B.CreateLoad(fieldTy, addr, f->name);
+  }
+  if (soaElement(e)) return genSoaLoad(genSoaRef(*static_cast<EIndex*>(&e)));
+  if (auto *idx = dynamic_cast<EIndex*>(&e); idx && idx->arr->ty->k==TyKind::Simd)
+    return B.CreateExtractElement(genExpr(*idx->arr), genExpr(*idx->idx), "lane");
+  if (auto *idx = dynamic_cast<EIndex*>(&e)){
     llvm::Type* elemType;
-    if (isArrayType) {
-      auto arrayType = llvm::cast<llvm::ArrayType>(pointeeType);
-      elemType = arrayType->getElementType();
-    } else {
-      // For pointers, the element type is the pointee type
-      elemType = pointeeType;
-    }
-    
-    // Generate the index expression
-    auto index = genExpr(*idx->idx);
-    
-    // Convert index to i32 (LLVM prefers i32 for GEP indices)
-    if (index->getType()->isIntegerTy(64)) {
-      index = B.CreateTrunc(index, llvm::Type::getInt32Ty(*ctx), "idx_trunc");
-    }
-    
-    llvm::Value* gep;
-    if (isArrayType) {
-      // For arrays: getelementptr inbounds [N x T], ptr %arr, i32 0, i32 %index
-      auto zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*ctx), 0);
-      gep = B.CreateInBoundsGEP(pointeeType, arrExpr, {zero, index}, "arrayidx");
-    } else {
-      // For pointers: getelementptr inbounds T, ptr %ptr, i32 %index
-      gep = B.CreateInBoundsGEP(elemType, arrExpr, index, "ptridx");
-    }
-    
-    // Load the element
-    auto load = B.CreateLoad(elemType, gep, "elem");
-    load->setAlignment(llvm::Align(8));
+    auto gep = genIndexAddr(*idx, elemType);
+    if (idx->ty->k==TyKind::Array) return gep; // nested arrays are used by address
     
-    return load;
+    // Load the element (alignment comes from the module DataLayout)
+    return B.CreateLoad(elemType, gep, "elem");
   }
   fatal("expr codegen");
 }
 
-void CodeGen::runDefers(std::vector<Expr*>& defers){
-  // Insert in reverse order to match LIFO semantics
-  for (int i=(int)defers.size()-1;i>=0;--i) (void)genExpr(*defers[i]);
+// Loop attributes become llvm.loop metadata on every back edge into `header`. #[independent]
+// also puts the loads and stores of the body (blocks from firstBody on) in an access group
+// listed as llvm.loop.parallel_accesses, so dependence checks are skipped for them.
+void CodeGen::attachLoopHints(const LoopHints& h, llvm::BasicBlock* header, llvm::BasicBlock* preheader, llvm::BasicBlock* firstBody){
+  auto i1 = llvm::Type::getInt1Ty(*ctx);
+  auto i32 = llvm::Type::getInt32Ty(*ctx);
+  auto flag = [&](const char* name, llvm::Constant* v) -> llvm::Metadata* {
+    return llvm::MDNode::get(*ctx, {llvm::MDString::get(*ctx, name), llvm::ConstantAsMetadata::get(v)});
+  };
+  std::vector<llvm::Metadata*> props;
+  if (h.vectorize) props.push_back(flag("llvm.loop.vectorize.enable", llvm::ConstantInt::getTrue(i1)));
+  if (h.vectorizeWidth) props.push_back(flag("llvm.loop.vectorize.width", llvm::ConstantInt::get(i32, h.vectorizeWidth)));
+  if (h.interleave) props.push_back(flag("llvm.loop.interleave.count", llvm::ConstantInt::get(i32, h.interleave)));
+  if (h.unroll==1) props.push_back(llvm::MDNode::get(*ctx, {llvm::MDString::get(*ctx, "llvm.loop.unroll.disable")}));
+  else if (h.unroll) props.push_back(flag("llvm.loop.unroll.count", llvm::ConstantInt::get(i32, h.unroll)));
+  if (h.independent){
+    auto group = llvm::MDNode::getDistinct(*ctx, {});
+    props.push_back(llvm::MDNode::get(*ctx, {llvm::MDString::get(*ctx, "llvm.loop.parallel_accesses"), group}));
+    auto F = header->getParent();
+    bool inBody = false;
+    for (auto& BB : *F){
+      if (&BB==firstBody) inBody = true;
+      if (!inBody) continue;
+      for (auto& I : BB)
+        if (llvm::isa<llvm::LoadInst>(I) || llvm::isa<llvm::StoreInst>(I))
+          I.setMetadata(llvm::LLVMContext::MD_access_group,
+                        llvm::uniteAccessGroups(I.getMetadata(llvm::LLVMContext::MD_access_group), group));
+    }
+  }
+  if (props.empty()) return;
+  std::vector<llvm::Metadata*> ops{nullptr};
+  ops.insert(ops.end(), props.begin(), props.end());
+  auto loopID = llvm::MDNode::getDistinct(*ctx, ops);
+  loopID->replaceOperandWith(0, loopID);
+  for (auto *pred : llvm::predecessors(header))
+    if (pred!=preheader) pred->getTerminator()->setMetadata(llvm::LLVMContext::MD_loop, loopID);
+}
+
+// `let p = alloc<T>(n);` directly followed by `for i in 0..n { p[i] = 0; }` (or false): the
+// allocation call, when the loop only rewrites memory that is already zero; null otherwise.
+ECall* CodeGen::zeroFillOf(Stmt& s, Stmt& next){
+  auto *sl = dynamic_cast<SLet*>(&s);
+  auto *c = sl ? dynamic_cast<ECall*>(sl->init.get()) : nullptr;
+  auto *sf = dynamic_cast<SFor*>(&next);
+  if (!c || sl->onStack || !sf || sf->gen || sf->stepValue!=1 || sf->body.size()!=1) return nullptr;
+  if ((c->callee!="alloc" && c->callee!="alloc_zeroed" && c->callee!="alloc_large") || userFuncs.count(c->callee)) return nullptr;
+  auto *from = dynamic_cast<EInt*>(sf->from.get());
+  auto *nv = dynamic_cast<EVar*>(c->args[0].get()), *tv = dynamic_cast<EVar*>(sf->to.get());
+  auto *ni = dynamic_cast<EInt*>(c->args[0].get()), *ti = dynamic_cast<EInt*>(sf->to.get());
+  if (!from || from->v!=0 || !((nv && tv && nv->name==tv->name) || (ni && ti && ni->v==ti->v))) return nullptr;
+  auto *se = dynamic_cast<SExpr*>(sf->body[0].get());
+  auto *st = se ? dynamic_cast<EBin*>(se->e.get()) : nullptr;
+  auto *ix = st && st->op==TokKind::Eq ? dynamic_cast<EIndex*>(st->lhs.get()) : nullptr;
+  auto *base = ix ? dynamic_cast<EVar*>(ix->arr.get()) : nullptr;
+  auto *i = ix ? dynamic_cast<EVar*>(ix->idx.get()) : nullptr;
+  if (!base || base->name!=sl->name || !i || i->name!=sf->var) return nullptr;
+  auto *zi = dynamic_cast<EInt*>(st->rhs.get());
+  auto *zb = dynamic_cast<EBool*>(st->rhs.get());
+  return (zi && zi->v==0) || (zb && !zb->v) ? c : nullptr;
+}
+
+void CodeGen::genStmts(std::vector<StmtPtr>& body, llvm::Function* fn){
+  for (size_t k=0; k<body.size(); ++k){
+    auto *fill = k+1<body.size() ? zeroFillOf(*body[k], *body[k+1]) : nullptr;
+    zeroedAlloc = fill; // a plain alloc<T> then comes from calloc
+    genStmt(*body[k], fn);
+    zeroedAlloc = nullptr;
+    if (fill) ++k;
+  }
+}
+
+void CodeGen::genBlock(std::vector<StmtPtr>& body, llvm::Function* fn){
+  // names the block declares go out of scope with it, uncovering any they shadowed
+  auto values = namedValues, ivs = inductionVars; auto types = namedTypes;
+  deferScopes.emplace_back();
+  genStmts(body, fn);
+  if (!builder->GetInsertBlock()->getTerminator()) runDefers(deferScopes.size()-1);
+  deferScopes.pop_back();
+  namedValues = std::move(values); inductionVars = std::move(ivs); namedTypes = std::move(types);
+}
+
+void CodeGen::pushDefer(Expr& e){
+  deferScopes.back().push_back({&e, namedValues, inductionVars, namedTypes});
+}
+
+void CodeGen::runDefers(size_t depth){
+  if (std::all_of(deferScopes.begin()+depth, deferScopes.end(), [](auto& s){ return s.empty(); })) return;
+  // a task spawned in the block may still use what its defers release; a return (depth 0)
+  // has already waited in endSpawnScope
+  if (spawnScope && depth>0) builder->CreateCall(mod->getFunction("aurora_sync"), {spawnScope});
+  auto values = namedValues, ivs = inductionVars; auto types = namedTypes;
+  for (size_t k=deferScopes.size(); k-- > depth; )
+    for (auto d = deferScopes[k].rbegin(); d!=deferScopes[k].rend(); ++d){
+      namedValues = d->values; inductionVars = d->ivs; namedTypes = d->types;
+      (void)genExpr(*d->e);
+    }
+  namedValues = std::move(values); inductionVars = std::move(ivs); namedTypes = std::move(types);
 }
 
 void CodeGen::genStmt(Stmt& s, llvm::Function* fn){
@@ -269,26 +1149,32 @@ void CodeGen::genStmt(Stmt& s, llvm::Function* fn){
       }
       else ty = llvm::Type::getInt64Ty(*ctx);
     }
-    auto alloca = B.CreateAlloca(ty, nullptr, sl->name);
-    
+    auto alloca = entryAlloca(ty, sl->name);
+
+    // a non-escaping unique alloc<T>(constant) of at most kStackBytes becomes a stack buffer
+    llvm::Value* stackBuf = nullptr;
+    if (sl->onStack){
+      constexpr uint64_t kStackBytes = 4096;
+      auto& c = static_cast<ECall&>(*sl->init);
+      auto elemTy = tyLLVM(*c.typeArgs[0]);
+      auto size = std::max<uint64_t>(mod->getDataLayout().getTypeAllocSize(elemTy), 1);
+      auto *n = llvm::dyn_cast<llvm::ConstantInt>(genExpr(*c.args[0]));
+      if (n && !n->isNegative() && !n->isZero() && n->getZExtValue() <= kStackBytes/size)
+        stackBuf = entryAlloca(llvm::ArrayType::get(elemTy, n->getZExtValue()), sl->name+".buf");
+    }
+
     // Handle array literal initialization differently
-    if (auto *arr = dynamic_cast<EArrayLit*>(sl->init.get())) {
-      // Get element type for array initialization
-      llvm::Type* elemType = nullptr;
-      if (!arr->elems.empty()) {
-        elemType = genExpr(*arr->elems[0])->getType();
-      }
-      
-      // Initialize array elements
-      for (size_t i = 0; i < arr->elems.size(); ++i){
-        auto idx = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*ctx), i);
-        auto zero = llvm::ConstantInt::get(llvm::Type::getInt32Ty(*ctx), 0);
-        auto ptr = B.CreateInBoundsGEP(ty, alloca, {zero, idx});
-        auto store = B.CreateStore(genExpr(*arr->elems[i]), ptr);
-        store->setAlignment(llvm::Align(8)); // 8-byte alignment for i64
-      }
+    if (stackBuf) {
+      B.CreateStore(stackBuf, alloca);
+    } else if (auto *arr = dynamic_cast<EArrayLit*>(sl->init.get())) {
+      for (size_t i = 0; i < arr->elems.size(); ++i) storeElem(alloca, *sl->annType, i, genExpr(*arr->elems[i]));
+    } else if (auto *rep = dynamic_cast<EArrayRepeat*>(sl->init.get())) {
+      fillArray(alloca, ty, genExpr(*rep->value));
     } else {
-      auto val = genExpr(*sl->init);
+      auto val = genValueAs(*sl->init, *sl->annType);
+      // arrays are addressed by pointer; copy the aggregate into the new slot
+      if (ty->isAggregateType() && val->getType()->isPointerTy())
+        val = B.CreateLoad(ty, val);
       // cast bool to i64 for storage if mismatched
       if (val->getType()!=ty){
         if (val->getType()->isIntegerTy(1) && ty->isIntegerTy(64))
@@ -300,24 +1186,26 @@ void CodeGen::genStmt(Stmt& s, llvm::Function* fn){
     }
     namedValues[sl->name]=alloca;
     namedTypes[sl->name]=ty;
+    inductionVars.erase(sl->name); // shadows an enclosing loop variable
 
-    if (sl->isUnique){
-      // implicit RAII: defer free(name)
-      auto v = std::make_unique<EVar>(sl->name);
-      auto call = std::make_unique<ECall>("free");
-      call->args.push_back(std::move(v));
-      auto tmp = call.release(); // leaked into defers; owned by AST in real impl
-      // naive: attach to function-level list on the side — handled in Sema; here we just ignore since we also support explicit `defer`.
-      (void)tmp;
-    }
+    if (sl->cleanup && !stackBuf) pushDefer(*sl->cleanup);
     return;
   }
   if (auto *se = dynamic_cast<SExpr*>(&s)){ (void)genExpr(*se->e); return; }
   if (auto *sr = dynamic_cast<SReturn*>(&s)){ 
+    destroyLiveGens();
+    if (curFunc->isGen){ B.CreateBr(gen.final); return; }
+    // the value is computed before the defers run, and tasks finish before cleanups free their memory
     if (sr->e) {
-      auto rv = genExpr(*sr->e); 
+      auto rv = genValueAs(*sr->e, *curFunc->ret); 
+      if (fn->getReturnType()->isAggregateType() && rv->getType()->isPointerTy())
+        rv = B.CreateLoad(fn->getReturnType(), rv);
+      endSpawnScope();
+      runDefers(0);
       B.CreateRet(rv); 
     } else {
+      endSpawnScope();
+      runDefers(0);
       B.CreateRetVoid();
     }
     return; 
@@ -331,20 +1219,30 @@ void CodeGen::genStmt(Stmt& s, llvm::Function* fn){
     auto MergeBB= llvm::BasicBlock::Create(*ctx, "ifend");
     B.CreateCondBr(cond, ThenBB, ElseBB);
     B.SetInsertPoint(ThenBB); 
-    for (auto& st : si->thenStmts) genStmt(*st, fn); 
+    genBlock(si->thenStmts, fn);
     if (!B.GetInsertBlock()->getTerminator()) B.CreateBr(MergeBB);
     
     TheFunction->insert(TheFunction->end(), ElseBB);
     B.SetInsertPoint(ElseBB); 
-    for (auto& st : si->elseStmts) genStmt(*st, fn); 
+    genBlock(si->elseStmts, fn);
     if (!B.GetInsertBlock()->getTerminator()) B.CreateBr(MergeBB);
     
     TheFunction->insert(TheFunction->end(), MergeBB);
     B.SetInsertPoint(MergeBB);
     return;
   }
+  if (auto *sf = dynamic_cast<SFor*>(&s); sf && sf->gen){ genForGen(*sf, fn); return; }
+  if (auto *sf = dynamic_cast<SFor*>(&s)){
+    auto from = genExpr(*sf->from), to = genExpr(*sf->to);
+    auto ivTy = from->getType()->getIntegerBitWidth() >= to->getType()->getIntegerBitWidth() ? from->getType() : to->getType();
+    from = B.CreateSExt(from, ivTy); to = B.CreateSExt(to, ivTy);
+    if (sf->parallel) genParallelFor(*sf, from, to, fn);
+    else genForLoop(*sf, from, to, fn);
+    return;
+  }
   if (auto *sw = dynamic_cast<SWhile*>(&s)){
     auto TheFunction = B.GetInsertBlock()->getParent();
+    auto PreBB = B.GetInsertBlock();
     auto CondBB = llvm::BasicBlock::Create(*ctx, "while.cond", TheFunction);
     auto BodyBB = llvm::BasicBlock::Create(*ctx, "while.body");
     auto EndBB  = llvm::BasicBlock::Create(*ctx, "while.end");
@@ -352,6 +1250,7 @@ void CodeGen::genStmt(Stmt& s, llvm::Function* fn){
     // Push loop blocks onto stacks for break/continue
     loopExitStack.push_back(EndBB);
     loopContinueStack.push_back(CondBB);
+    loopDeferDepth.push_back(deferScopes.size());
     
     B.CreateBr(CondBB);
     B.SetInsertPoint(CondBB);
@@ -360,24 +1259,36 @@ void CodeGen::genStmt(Stmt& s, llvm::Function* fn){
     B.CreateCondBr(c, BodyBB, EndBB);
     TheFunction->insert(TheFunction->end(), BodyBB);
     B.SetInsertPoint(BodyBB);
-    for (auto& st : sw->body) genStmt(*st, fn);
+    genBlock(sw->body, fn);
     if (!B.GetInsertBlock()->getTerminator()) B.CreateBr(CondBB);
+    attachLoopHints(sw->hints, CondBB, PreBB, BodyBB);
     
     // Pop loop blocks from stacks
     loopExitStack.pop_back();
     loopContinueStack.pop_back();
+    loopDeferDepth.pop_back();
     
     TheFunction->insert(TheFunction->end(), EndBB);
     B.SetInsertPoint(EndBB);
     return;
   }
-  if (auto *sd = dynamic_cast<SDefer*>(&s)){
-    (void)sd; /* in this MVP, explicit 'defer' can be inlined earlier by Sema; for brevity omitted */
+  if (auto *sd = dynamic_cast<SDefer*>(&s)){ pushDefer(*sd->e); return; }
+  
+  if (auto *sy = dynamic_cast<SYield*>(&s)){
+    auto promTy = tyLLVM(*curFunc->ret);
+    auto v = genValueAs(*sy->e, *curFunc->ret);
+    if (promTy->isAggregateType() && v->getType()->isPointerTy()) v = B.CreateLoad(promTy, v);
+    B.CreateStore(v, gen.promise);
+    genSuspend(false);
+    return;
+  }
+  if (dynamic_cast<SSync*>(&s)){
+    if (spawnScope) B.CreateCall(mod->getFunction("aurora_sync"), {spawnScope});
     return;
   }
-  
   if (dynamic_cast<SBreak*>(&s)){
     if (loopExitStack.empty()) fatal("break statement outside of loop");
+    runDefers(loopDeferDepth.back());
     B.CreateBr(loopExitStack.back());
     // Create a new block after break (unreachable code)
     auto TheFunction = B.GetInsertBlock()->getParent();
@@ -388,6 +1299,7 @@ void CodeGen::genStmt(Stmt& s, llvm::Function* fn){
   
   if (dynamic_cast<SContinue*>(&s)){
     if (loopContinueStack.empty()) fatal("continue statement outside of loop");
+    runDefers(loopDeferDepth.back());
     B.CreateBr(loopContinueStack.back());
     // Create a new block after continue (unreachable code)
     auto TheFunction = B.GetInsertBlock()->getParent();
@@ -397,17 +1309,364 @@ void CodeGen::genStmt(Stmt& s, llvm::Function* fn){
   }
 }
 
+// t is an array or a struct with one somewhere inside; the body may store to its elements
+static bool holdsArray(llvm::Type* t){
+  if (t->isArrayTy()) return true;
+  auto *st = llvm::dyn_cast<llvm::StructType>(t);
+  return st && std::any_of(st->element_begin(), st->element_end(), holdsArray);
+}
+
+// The body of a parallel for becomes an internal function body(env, lo, hi) that runs a counted
+// loop over its chunk. env is an array holding the address of each captured local. Reduction
+// variables get a private accumulator, initialized to the operator's identity, which is
+// combined into the shared variable atomically when the chunk is done.
+void CodeGen::genParallelFor(SFor& sf, llvm::Value* from, llvm::Value* to, llvm::Function* fn){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto i64 = llvm::Type::getInt64Ty(*ctx);
+  auto ptrTy = llvm::PointerType::getUnqual(*ctx);
+  auto ivTy = from->getType();
+
+  std::vector<llvm::Value*> addrs;
+  std::vector<llvm::Type*> types;
+  for (auto& name : sf.captures){
+    if (auto iv = inductionVars.find(name); iv!=inductionVars.end()){
+      auto slot = entryAlloca(iv->second->getType(), name+".cap");
+      B.CreateStore(iv->second, slot);
+      addrs.push_back(slot); types.push_back(iv->second->getType());
+      continue;
+    }
+    addrs.push_back(namedValues.at(name)); types.push_back(namedTypes.at(name));
+  }
+  auto envTy = llvm::ArrayType::get(ptrTy, std::max<size_t>(addrs.size(), 1));
+  auto env = entryAlloca(envTy, "par.env");
+  for (size_t k=0; k<addrs.size(); ++k) B.CreateStore(addrs[k], B.CreateConstInBoundsGEP2_32(envTy, env, 0, (unsigned)k));
+
+  auto FT = llvm::FunctionType::get(llvm::Type::getVoidTy(*ctx), {ptrTy, i64, i64}, false);
+  auto body = llvm::Function::Create(FT, llvm::Function::InternalLinkage, fn->getName()+".par", mod.get());
+  body->setDoesNotThrow();
+  body->getArg(0)->setName("env");
+  body->addParamAttr(0, llvm::Attribute::NoAlias);
+  body->addParamAttr(0, llvm::Attribute::ReadOnly);
+
+  // the outlined function has its own variables and loop stack
+  auto savedIP = B.saveIP();
+  auto savedValues = std::move(namedValues); auto savedTypes = std::move(namedTypes);
+  auto savedIVs = std::move(inductionVars);
+  auto savedScope = spawnScope; spawnScope = nullptr; // Sema rejects spawn in the body
+  auto savedGens = std::move(liveGens); liveGens.clear(); // and return
+  auto savedExits = std::move(loopExitStack); auto savedConts = std::move(loopContinueStack);
+  auto savedDepths = std::move(loopDeferDepth); auto savedDefers = std::move(deferScopes);
+  namedValues.clear(); namedTypes.clear(); inductionVars.clear(); loopExitStack.clear(); loopContinueStack.clear();
+  loopDeferDepth.clear(); deferScopes.clear();
+  for (auto& [name, GV] : constGlobals){ namedValues[name]=GV; namedTypes[name]=GV->getValueType(); }
+
+  B.SetInsertPoint(llvm::BasicBlock::Create(*ctx, "entry", body));
+  // Sema keeps shared locals read-only here, so everything but arrays (whose elements the
+  // body may write) and atomics is copied in once and becomes an SSA value after mem2reg
+  for (size_t k=0; k<sf.captures.size(); ++k){
+    auto& name = sf.captures[k];
+    auto ty = types[k];
+    llvm::Value* p = B.CreateLoad(ptrTy, B.CreateConstInBoundsGEP2_32(envTy, body->getArg(0), 0, (unsigned)k), name+".ref");
+    // a struct with an array inside is shared too: s.arr[i] = v must reach the caller's s
+    bool shared = holdsArray(ty) || (ty->isStructTy() && !llvm::cast<llvm::StructType>(ty)->hasName() &&
+                                     ty!=sliceType() && ty!=vecType()); // soa columns
+    bool reduced = std::any_of(sf.reductions.begin(), sf.reductions.end(), [&](const Reduction& r){ return r.var==name; });
+    bool atomic = std::find(sf.atomicCaptures.begin(), sf.atomicCaptures.end(), name)!=sf.atomicCaptures.end();
+    if (!shared && !reduced && !atomic){
+      auto copy = entryAlloca(ty, name);
+      B.CreateStore(B.CreateLoad(ty, p), copy);
+      p = copy;
+    }
+    namedValues[name] = p;
+    namedTypes[name] = ty;
+  }
+  std::vector<std::pair<llvm::Value*, llvm::Value*>> partials; // shared, private
+  for (auto& r : sf.reductions){
+    auto ty = llvm::cast<llvm::IntegerType>(namedTypes[r.var]);
+    auto w = ty->getBitWidth();
+    llvm::APInt id = r.op=="+" ? llvm::APInt(w, 0) : r.op=="*" ? llvm::APInt(w, 1)
+                   : r.op=="min" ? llvm::APInt::getSignedMaxValue(w) : llvm::APInt::getSignedMinValue(w);
+    auto acc = entryAlloca(ty, r.var+".part");
+    B.CreateStore(llvm::ConstantInt::get(ty, id), acc);
+    partials.push_back({namedValues[r.var], acc});
+    namedValues[r.var] = acc;
+  }
+  auto lo = B.CreateTrunc(body->getArg(1), ivTy), hi = B.CreateTrunc(body->getArg(2), ivTy);
+  genForLoop(sf, lo, hi, body);
+  for (size_t k=0; k<sf.reductions.size(); ++k){
+    auto [shared, acc] = partials[k];
+    auto ty = namedTypes[sf.reductions[k].var];
+    auto v = B.CreateLoad(ty, acc);
+    auto& op = sf.reductions[k].op;
+    if (op!="*"){
+      auto rmw = op=="+" ? llvm::AtomicRMWInst::Add : op=="min" ? llvm::AtomicRMWInst::Min : llvm::AtomicRMWInst::Max;
+      B.CreateAtomicRMW(rmw, shared, v, llvm::MaybeAlign(), llvm::AtomicOrdering::Monotonic);
+      continue;
+    }
+    // no atomic multiply: retry a compare-exchange until no other chunk intervened
+    auto Pre = B.GetInsertBlock();
+    auto Retry = llvm::BasicBlock::Create(*ctx, "red.retry", body);
+    auto Done = llvm::BasicBlock::Create(*ctx, "red.done", body);
+    auto init = B.CreateLoad(ty, shared);
+    B.CreateBr(Retry);
+    B.SetInsertPoint(Retry);
+    auto cur = B.CreatePHI(ty, 2);
+    cur->addIncoming(init, Pre);
+    auto res = B.CreateAtomicCmpXchg(shared, cur, B.CreateMul(cur, v), llvm::MaybeAlign(),
+                                     llvm::AtomicOrdering::Monotonic, llvm::AtomicOrdering::Monotonic);
+    cur->addIncoming(B.CreateExtractValue(res, 0), Retry);
+    B.CreateCondBr(B.CreateExtractValue(res, 1), Done, Retry);
+    B.SetInsertPoint(Done);
+  }
+  B.CreateRetVoid();
+  if (llvm::verifyFunction(*body, &llvm::errs())) fatal("invalid function IR");
+
+  namedValues = std::move(savedValues); namedTypes = std::move(savedTypes);
+  inductionVars = std::move(savedIVs);
+  spawnScope = savedScope;
+  liveGens = std::move(savedGens);
+  loopExitStack = std::move(savedExits); loopContinueStack = std::move(savedConts);
+  loopDeferDepth = std::move(savedDepths); deferScopes = std::move(savedDefers);
+  B.restoreIP(savedIP);
+
+  // iterations = ceil((to - from) / step), or none for an empty range
+  auto from64 = B.CreateSExt(from, i64), to64 = B.CreateSExt(to, i64);
+  auto step = llvm::ConstantInt::get(i64, sf.stepValue);
+  auto span = B.CreateSub(to64, from64);
+  auto n = B.CreateUDiv(B.CreateAdd(span, llvm::ConstantInt::get(i64, sf.stepValue-1)), step);
+  n = B.CreateSelect(B.CreateICmpSLT(from64, to64), n, llvm::ConstantInt::get(i64, 0), "par.n");
+  B.CreateCall(mod->getFunction("aurora_parallel_for"), {body, env, from64, n, step});
+}
+
+// Counted loops are emitted rotated: the guard skips the loop when from >= to, the variable
+// is a phi in the body's first block, and the single latch increments (nsw) and re-tests.
+// A step above 1 is tested before the increment, as to - i > step, so i + step never
+// overflows near the type's maximum.
+void CodeGen::genForLoop(SFor& sf, llvm::Value* from, llvm::Value* to, llvm::Function* fn){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto TheFunction = B.GetInsertBlock()->getParent();
+  auto ivTy = from->getType();
+  auto PreBB = B.GetInsertBlock();
+  auto BodyBB = llvm::BasicBlock::Create(*ctx, "for.body", TheFunction);
+  auto LatchBB = llvm::BasicBlock::Create(*ctx, "for.latch");
+  auto EndBB = llvm::BasicBlock::Create(*ctx, "for.end");
+  B.CreateCondBr(B.CreateICmpSLT(from, to), BodyBB, EndBB);
+
+  B.SetInsertPoint(BodyBB);
+  auto iv = B.CreatePHI(ivTy, 2, sf.var);
+  iv->addIncoming(from, PreBB);
+  auto outer = inductionVars.find(sf.var);
+  llvm::Value* saved = outer!=inductionVars.end() ? outer->second : nullptr;
+  inductionVars[sf.var] = iv;
+  loopExitStack.push_back(EndBB);
+  loopContinueStack.push_back(LatchBB);
+  loopDeferDepth.push_back(deferScopes.size());
+  genBlock(sf.body, fn);
+  if (!B.GetInsertBlock()->getTerminator()) B.CreateBr(LatchBB);
+  loopExitStack.pop_back();
+  loopContinueStack.pop_back();
+  loopDeferDepth.pop_back();
+  if (saved) inductionVars[sf.var] = saved; else inductionVars.erase(sf.var);
+
+  TheFunction->insert(TheFunction->end(), LatchBB);
+  B.SetInsertPoint(LatchBB);
+  auto step = llvm::ConstantInt::get(ivTy, sf.stepValue);
+  // i < to here, so to - i is exact as an unsigned value
+  auto more = sf.stepValue==1 ? nullptr : B.CreateICmpUGT(B.CreateSub(to, iv), step, sf.var+".more");
+  auto next = B.CreateAdd(iv, step, sf.var+".next", false, true);
+  iv->addIncoming(next, LatchBB);
+  B.CreateCondBr(more ? more : B.CreateICmpSLT(next, to), BodyBB, EndBB);
+  attachLoopHints(sf.hints, BodyBB, PreBB, BodyBB);
+
+  TheFunction->insert(TheFunction->end(), EndBB);
+  B.SetInsertPoint(EndBB);
+}
+
+// A gen fn is an LLVM switched-resume coroutine. The ramp gets its frame from coro.alloc (CoroElide
+// drops the malloc when the consuming loop keeps the handle local), stores the parameters, suspends
+// and returns the handle. yield stores into the promise slot and suspends; the consuming loop
+// resumes it, stops at the final suspend (coro.done) and destroys it on every way out.
+void CodeGen::beginGen(llvm::Function* F){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto ptrTy = llvm::PointerType::getUnqual(*ctx);
+  auto null = llvm::ConstantPointerNull::get(ptrTy);
+  F->setPresplitCoroutine();
+  gen.promise = entryAlloca(tyLLVM(*curFunc->ret), "promise");
+  gen.id = B.CreateIntrinsic(llvm::Intrinsic::coro_id, {}, {B.getInt32(0), gen.promise, null, null}, nullptr, "id");
+  auto PreBB = B.GetInsertBlock();
+  auto AllocBB = llvm::BasicBlock::Create(*ctx, "coro.alloc", F);
+  auto BeginBB = llvm::BasicBlock::Create(*ctx, "coro.begin", F);
+  B.CreateCondBr(B.CreateIntrinsic(llvm::Intrinsic::coro_alloc, {}, {gen.id}), AllocBB, BeginBB);
+  B.SetInsertPoint(AllocBB);
+  auto size = B.CreateIntrinsic(llvm::Intrinsic::coro_size, {B.getInt64Ty()}, {});
+  auto mem = B.CreateCall(mod->getFunction("malloc"), {size}, "frame");
+  B.CreateBr(BeginBB);
+  B.SetInsertPoint(BeginBB);
+  auto phi = B.CreatePHI(ptrTy, 2, "frame.mem");
+  phi->addIncoming(null, PreBB);
+  phi->addIncoming(mem, AllocBB);
+  gen.hdl = B.CreateIntrinsic(llvm::Intrinsic::coro_begin, {}, {gen.id, phi}, nullptr, "hdl");
+  gen.final = llvm::BasicBlock::Create(*ctx, "coro.final");
+  gen.cleanup = llvm::BasicBlock::Create(*ctx, "coro.cleanup");
+  gen.suspend = llvm::BasicBlock::Create(*ctx, "coro.suspend");
+}
+
+// coro.suspend yields -1 when the coroutine suspends, 0 when it is resumed and 1 when destroyed.
+void CodeGen::genSuspend(bool final){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto F = B.GetInsertBlock()->getParent();
+  auto s = B.CreateIntrinsic(llvm::Intrinsic::coro_suspend, {}, {llvm::ConstantTokenNone::get(*ctx), B.getInt1(final)});
+  auto ResumeBB = llvm::BasicBlock::Create(*ctx, final ? "coro.done" : "gen.resume", F);
+  auto DestroyBB = llvm::BasicBlock::Create(*ctx, "gen.destroy", F);
+  auto sw = B.CreateSwitch(s, gen.suspend, 2);
+  sw->addCase(B.getInt8(0), ResumeBB);
+  sw->addCase(B.getInt8(1), DestroyBB);
+  B.SetInsertPoint(DestroyBB);
+  destroyLiveGens();
+  B.CreateBr(gen.cleanup);
+  B.SetInsertPoint(ResumeBB);
+  if (final) B.CreateUnreachable(); // resuming a finished generator is undefined
+}
+
+void CodeGen::endGen(llvm::Function* F){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  if (!B.GetInsertBlock()->getTerminator()) B.CreateBr(gen.final);
+  F->insert(F->end(), gen.final);
+  B.SetInsertPoint(gen.final);
+  genSuspend(true);
+
+  F->insert(F->end(), gen.cleanup);
+  B.SetInsertPoint(gen.cleanup);
+  auto mem = B.CreateIntrinsic(llvm::Intrinsic::coro_free, {}, {gen.id, gen.hdl}, nullptr, "frame");
+  auto FreeBB = llvm::BasicBlock::Create(*ctx, "coro.free", F);
+  B.CreateCondBr(B.CreateIsNotNull(mem), FreeBB, gen.suspend);
+  B.SetInsertPoint(FreeBB);
+  B.CreateCall(mod->getFunction("free"), {mem});
+  B.CreateBr(gen.suspend);
+
+  F->insert(F->end(), gen.suspend);
+  B.SetInsertPoint(gen.suspend);
+  auto end = llvm::Intrinsic::getDeclaration(mod.get(), llvm::Intrinsic::coro_end);
+  std::vector<llvm::Value*> args{gen.hdl, B.getFalse()};
+  if (end->arg_size()==3) args.push_back(llvm::ConstantTokenNone::get(*ctx));
+  B.CreateCall(end, args);
+  B.CreateRet(gen.hdl);
+  gen = GenFrame{};
+}
+
+void CodeGen::destroyLiveGens(){
+  for (auto it=liveGens.rbegin(); it!=liveGens.rend(); ++it)
+    builder->CreateIntrinsic(llvm::Intrinsic::coro_destroy, {}, {*it});
+}
+
+// for x in g(args): call the ramp, then resume until the generator reaches its final suspend.
+void CodeGen::genForGen(SFor& sf, llvm::Function* fn){
+  auto& B = *static_cast<BuilderWrap*>(builder.get());
+  auto& c = static_cast<ECall&>(*sf.gen);
+  auto G = functions.at(c.callee);
+  auto hdl = B.CreateCall(G, genCallArgs(c), c.callee+".gen");
+  hdl->setCallingConv(G->getCallingConv());
+  auto TheFunction = B.GetInsertBlock()->getParent();
+  auto PreBB = B.GetInsertBlock();
+  auto HeadBB = llvm::BasicBlock::Create(*ctx, "gen.next", TheFunction);
+  auto BodyBB = llvm::BasicBlock::Create(*ctx, "gen.body");
+  auto EndBB = llvm::BasicBlock::Create(*ctx, "gen.end");
+  B.CreateBr(HeadBB);
+  B.SetInsertPoint(HeadBB);
+  B.CreateIntrinsic(llvm::Intrinsic::coro_resume, {}, {hdl});
+  B.CreateCondBr(B.CreateIntrinsic(llvm::Intrinsic::coro_done, {}, {hdl}), EndBB, BodyBB);
+
+  TheFunction->insert(TheFunction->end(), BodyBB);
+  B.SetInsertPoint(BodyBB);
+  auto elemTy = tyLLVM(*c.ty);
+  auto align = mod->getDataLayout().getABITypeAlign(elemTy).value();
+  auto slot = B.CreateIntrinsic(llvm::Intrinsic::coro_promise, {}, {hdl, B.getInt32(align), B.getFalse()});
+  auto outer = inductionVars.find(sf.var);
+  llvm::Value* saved = outer!=inductionVars.end() ? outer->second : nullptr;
+  inductionVars[sf.var] = B.CreateLoad(elemTy, slot, sf.var);
+  liveGens.push_back(hdl);
+  loopExitStack.push_back(EndBB);
+  loopContinueStack.push_back(HeadBB);
+  loopDeferDepth.push_back(deferScopes.size());
+  genBlock(sf.body, fn);
+  if (!B.GetInsertBlock()->getTerminator()) B.CreateBr(HeadBB);
+  loopExitStack.pop_back();
+  loopContinueStack.pop_back();
+  loopDeferDepth.pop_back();
+  liveGens.pop_back();
+  if (saved) inductionVars[sf.var] = saved; else inductionVars.erase(sf.var);
+  attachLoopHints(sf.hints, HeadBB, PreBB, BodyBB);
+
+  TheFunction->insert(TheFunction->end(), EndBB);
+  B.SetInsertPoint(EndBB);
+  B.CreateIntrinsic(llvm::Intrinsic::coro_destroy, {}, {hdl});
+}
+
 void CodeGen::emit(Program& p){
-  // declare functions
+  for (auto& s : p.structs) structDecls[s->name] = s.get();
+
+  // constants: scalars fold to immediates, arrays become read-only globals
+  for (auto& c : p.consts){
+    auto init = constLLVM(c->value, *c->ty);
+    if (c->ty->k!=TyKind::Array){ constValues[c->name] = init; continue; }
+    auto GV = new llvm::GlobalVariable(*mod, init->getType(), /*isConstant*/true,
+                                       llvm::GlobalValue::InternalLinkage, init, c->name);
+    GV->setUnnamedAddr(llvm::GlobalValue::UnnamedAddr::Global);
+    constGlobals[c->name] = GV;
+  }
+
+  // declare functions; fixed arrays and vec headers are passed by reference, slices as (data, len)
+  auto& DL = mod->getDataLayout();
   for (auto& fn : p.funcs){
+    userFuncs[fn->name] = fn.get();
     std::vector<llvm::Type*> params;
-    for (auto& pr : fn->params) params.push_back(tyLLVM(*pr.ty));
-    auto FT = llvm::FunctionType::get(tyLLVM(*fn->ret), params, false);
-    auto F = llvm::Function::Create(FT, llvm::Function::ExternalLinkage, fn->name, mod.get());
+    for (auto& pr : fn->params){
+      if (pr.ty->k==TyKind::Array || pr.ty->k==TyKind::Vec) params.push_back(llvm::PointerType::getUnqual(*ctx));
+      else if (pr.ty->k==TyKind::Slice){ params.push_back(llvm::PointerType::getUnqual(*ctx)); params.push_back(llvm::Type::getInt64Ty(*ctx)); }
+      else params.push_back(tyLLVM(*pr.ty));
+    }
+    auto FT = llvm::FunctionType::get(fn->isGen ? llvm::PointerType::getUnqual(*ctx) : tyLLVM(*fn->ret), params, false);
+    bool external = !wholeProgram || fn->isExport || fn->name=="main";
+    auto F = llvm::Function::Create(FT, external ? llvm::Function::ExternalLinkage : llvm::Function::InternalLinkage,
+                                    fn->name, mod.get());
+    if (!external) F->setCallingConv(llvm::CallingConv::Fast);
     functions[fn->name]=F;
 
-    // name params
-    unsigned idx=0; for (auto &arg : F->args()) arg.setName(fn->params[idx++].name);
+    auto& fx = fn->effects;
+    if (fx.noUnwind) F->setDoesNotThrow();
+    if (fx.pure) F->setDoesNotAccessMemory();
+    else if (fx.readOnly) F->setOnlyReadsMemory();
+    if (fx.pure || fx.readOnly){ F->addFnAttr(llvm::Attribute::NoSync); F->addFnAttr(llvm::Attribute::NoFree); }
+    if (fx.willReturn) F->addFnAttr(llvm::Attribute::WillReturn);
+    if (!fx.recursive) F->setDoesNotRecurse();
+
+    // name params; noalias only holds for Aurora callers, so exported functions never get it
+    unsigned ai=0;
+    for (auto& pr : fn->params){
+      bool noalias = pr.noalias && !external;
+      if (pr.ty->k==TyKind::Array){
+        auto arrTy = tyLLVM(*pr.ty);
+        F->getArg(ai)->setName(pr.name);
+        F->addParamAttr(ai, llvm::Attribute::NonNull);
+        F->addDereferenceableParamAttr(ai, DL.getTypeAllocSize(arrTy));
+        F->addParamAttr(ai, llvm::Attribute::getWithAlignment(*ctx, DL.getABITypeAlign(arrTy)));
+        if (noalias) F->addParamAttr(ai, llvm::Attribute::NoAlias);
+        ai++;
+      } else if (pr.ty->k==TyKind::Vec){
+        F->getArg(ai)->setName(pr.name);
+        F->addParamAttr(ai, llvm::Attribute::NonNull);
+        F->addDereferenceableParamAttr(ai, DL.getTypeAllocSize(vecType()));
+        F->addParamAttr(ai, llvm::Attribute::getWithAlignment(*ctx, DL.getABITypeAlign(vecType())));
+        ai++;
+      } else if (pr.ty->k==TyKind::Slice){
+        F->getArg(ai)->setName(pr.name+".ptr");
+        F->getArg(ai+1)->setName(pr.name+".len");
+        if (noalias) F->addParamAttr(ai, llvm::Attribute::NoAlias);
+        ai+=2;
+      } else {
+        F->getArg(ai++)->setName(pr.name);
+      }
+    }
   }
 
   // define functions
@@ -417,26 +1676,91 @@ void CodeGen::emit(Program& p){
     builder->SetInsertPoint(entry);
     namedValues.clear();
     namedTypes.clear();
-    // allocate params on stack
-    unsigned idx=0; for (auto &arg : F->args()){
-      auto alloca = builder->CreateAlloca(arg.getType(), nullptr, arg.getName());
-      builder->CreateStore(&arg, alloca);
-      namedValues[std::string(arg.getName())]=alloca;
-      namedTypes[std::string(arg.getName())]=arg.getType();
-      idx++;
+    for (auto& [name, GV] : constGlobals){ namedValues[name]=GV; namedTypes[name]=GV->getValueType(); }
+    curFunc = fn.get();
+    spawnScope = nullptr;
+    if (fn->spawns){
+      spawnScope = entryAlloca(llvm::PointerType::getUnqual(*ctx), "spawn.scope");
+      builder->CreateStore(llvm::ConstantPointerNull::get(llvm::PointerType::getUnqual(*ctx)), spawnScope);
     }
-    for (auto& st : fn->body) genStmt(*st, F);
+    if (fn->isGen) beginGen(F);
+    // allocate params on stack; array and vec params are already addresses
+    unsigned ai=0;
+    for (auto& pr : fn->params){
+      auto ty = tyLLVM(*pr.ty);
+      if (pr.ty->k==TyKind::Array || pr.ty->k==TyKind::Vec){
+        namedValues[pr.name]=F->getArg(ai++);
+        namedTypes[pr.name]=ty;
+        continue;
+      }
+      llvm::Value* v = F->getArg(ai++);
+      if (pr.ty->k==TyKind::Slice){
+        llvm::Value* s = llvm::UndefValue::get(sliceType());
+        s = builder->CreateInsertValue(s, v, 0);
+        v = builder->CreateInsertValue(s, F->getArg(ai++), 1);
+      }
+      auto alloca = entryAlloca(ty, pr.name);
+      builder->CreateStore(v, alloca);
+      namedValues[pr.name]=alloca;
+      namedTypes[pr.name]=ty;
+    }
+    if (fn->isGen) genSuspend(false); // the ramp returns before the body runs
+    deferScopes.emplace_back();
+    genStmts(fn->body, F);
+    if (fn->isGen) endGen(F);
     // Add implicit return if the current block has no terminator
-    if (!builder->GetInsertBlock()->getTerminator()){
-      if (fn->ret->k==TyKind::I64) builder->CreateRet(llvm::ConstantInt::get(llvm::Type::getInt64Ty(*ctx), 0));
-      else if (fn->ret->k==TyKind::Bool) builder->CreateRet(llvm::ConstantInt::get(llvm::Type::getInt1Ty(*ctx), 0));
-      else if (fn->ret->k==TyKind::Void) builder->CreateRetVoid();
-      else builder->CreateRetVoid();
+    else if (!builder->GetInsertBlock()->getTerminator()){
+      endSpawnScope();
+      runDefers(0);
+      if (fn->ret->k==TyKind::Void) builder->CreateRetVoid();
+      else builder->CreateRet(llvm::Constant::getNullValue(F->getReturnType()));
     }
+    deferScopes.pop_back();
     if (llvm::verifyFunction(*F, &llvm::errs())) fatal("invalid function IR");
   }
 }
 
+namespace {
+// Prints the passes' remarks (vectorized, unrolled, or why not) for each function.
+struct RemarkPrinter : llvm::DiagnosticHandler {
+  bool isAnalysisRemarkEnabled(llvm::StringRef pass) const override { return interesting(pass); }
+  bool isAnyRemarkEnabled() const override { return true; }
+  bool isMissedOptRemarkEnabled(llvm::StringRef pass) const override { return interesting(pass); }
+  bool isPassedOptRemarkEnabled(llvm::StringRef pass) const override { return interesting(pass); }
+  static bool interesting(llvm::StringRef pass){ return pass=="loop-vectorize" || pass=="loop-unroll" || pass=="slp-vectorizer"; }
+  bool handleDiagnostics(const llvm::DiagnosticInfo& DI) override {
+    auto *R = llvm::dyn_cast<llvm::DiagnosticInfoOptimizationBase>(&DI);
+    if (!R) return false;
+    if (!R->isEnabled() || !interesting(R->getPassName())) return true; // drop other passes' remarks
+    llvm::errs() << "remark: " << R->getFunction().getName() << ": " << R->getPassName() << ": " << R->getMsg() << "\n";
+    return true;
+  }
+};
+}
+
+void CodeGen::optimize(int level){
+  if (remarks) ctx->setDiagnosticHandler(std::make_unique<RemarkPrinter>());
+  llvm::LoopAnalysisManager LAM;
+  llvm::FunctionAnalysisManager FAM;
+  llvm::CGSCCAnalysisManager CGAM;
+  llvm::ModuleAnalysisManager MAM;
+  llvm::PassBuilder PB(tm.get());
+  PB.registerModuleAnalyses(MAM);
+  PB.registerCGSCCAnalyses(CGAM);
+  PB.registerFunctionAnalyses(FAM);
+  PB.registerLoopAnalyses(LAM);
+  PB.crossRegisterProxies(LAM, FAM, CGAM, MAM);
+
+  llvm::ModulePassManager MPM;
+  switch (level){
+    case 0: MPM = PB.buildO0DefaultPipeline(llvm::OptimizationLevel::O0); break;
+    case 1: MPM = PB.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O1); break;
+    case 2: MPM = PB.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O2); break;
+    default: MPM = PB.buildPerModuleDefaultPipeline(llvm::OptimizationLevel::O3); break;
+  }
+  MPM.run(*mod, MAM);
+}
+
 void CodeGen::writeIR(const std::string& path){
   std::error_code EC; llvm::raw_fd_ostream out(path, EC, llvm::sys::fs::OF_Text);
   if (EC) fatal("cannot write IR");
@@ -444,18 +1768,9 @@ void CodeGen::writeIR(const std::string& path){
 }
 
 void CodeGen::writeObject(const std::string& path){
-  llvm::InitializeNativeTarget(); llvm::InitializeNativeTargetAsmPrinter(); llvm::InitializeNativeTargetAsmParser();
-  auto targetTriple = llvm::sys::getDefaultTargetTriple();
-  mod->setTargetTriple(targetTriple);
-  std::string Error; auto Target = llvm::TargetRegistry::lookupTarget(targetTriple, Error);
-  if (!Target) fatal(Error);
-  llvm::TargetOptions opt; auto RM = std::optional<llvm::Reloc::Model>();
-  auto TM = std::unique_ptr<llvm::TargetMachine>(Target->createTargetMachine(targetTriple, "generic", "", opt, RM));
-  mod->setDataLayout(TM->createDataLayout());
-
   std::error_code EC; llvm::raw_fd_ostream dest(path, EC, llvm::sys::fs::OF_None);
   if (EC) fatal("could not open obj file");
   llvm::legacy::PassManager pm;
-  if (TM->addPassesToEmitFile(pm, dest, nullptr, llvm::CGFT_ObjectFile)) fatal("TargetMachine can't emit obj");
+  if (tm->addPassesToEmitFile(pm, dest, nullptr, llvm::CGFT_ObjectFile)) fatal("TargetMachine can't emit obj");
   pm.run(*mod); dest.flush();
 }
\ No newline at end of file
@@ -6,31 +6,111 @@
 #include <string>
 #include <unordered_map>
 
-namespace llvm { class LLVMContext; class Module; class IRBuilderBase; class Value; class Function; class TargetMachine; class Type; class BasicBlock; }
+namespace llvm { class LLVMContext; class Module; class IRBuilderBase; class Value; class Function; class TargetMachine; class Type; class BasicBlock; class Constant; class GlobalVariable; class IntegerType; class StructType; class AllocaInst; class Twine; }
 
 struct CodeGen {
   std::unique_ptr<llvm::LLVMContext> ctx;
   std::unique_ptr<llvm::Module> mod;
   std::unique_ptr<llvm::IRBuilderBase> builder; // we’ll actually use IRBuilder<>
+  std::unique_ptr<llvm::TargetMachine> tm;
+  bool wholeProgram = true; // only main and `export fn` are visible outside the module
+  bool remarks = false;     // print vectorizer/unroller remarks to stderr
+  bool allocProfile = false; // heap allocations go through the runtime's per-line profiling hooks
 
   std::unordered_map<std::string, llvm::Value*> namedValues;
   std::unordered_map<std::string, llvm::Type*> namedTypes; // Track variable types for LLVM 17+
   std::unordered_map<std::string, llvm::Function*> functions;
+  std::unordered_map<std::string, Func*> userFuncs;
+  Func* curFunc = nullptr;
+  std::unordered_map<std::string, llvm::Constant*> constValues;     // scalar `const` bindings
+  std::unordered_map<std::string, llvm::Value*> inductionVars;      // for-loop variables (SSA phis)
+  std::unordered_map<std::string, llvm::GlobalVariable*> constGlobals; // array `const` bindings
   
   // Stack of loop exit blocks for break/continue
   std::vector<llvm::BasicBlock*> loopExitStack;
   std::vector<llvm::BasicBlock*> loopContinueStack;
+  std::vector<size_t> loopDeferDepth; // deferScopes.size() outside each enclosing loop's body
 
-  CodeGen(const std::string& moduleName);
+  CodeGen(const std::string& moduleName, const std::string& cpu = "generic"); // cpu: LLVM CPU name or "native"
   ~CodeGen();  // Destructor needed for unique_ptr with forward declarations
   void emit(Program& p);
+  void optimize(int level); // 0-3, LLVM's default pipelines
   void writeObject(const std::string& path);
   void writeIR(const std::string& path);
 
 private:
   llvm::Value* genExpr(Expr& e);
+  llvm::Value* genIndexAddr(EIndex& ix, llvm::Type*& elemTy);
+  llvm::Value* genElemAddr(Expr& arr, Expr& idx, llvm::Type*& elemTy); // &arr[idx]
+  llvm::Value* genSimdOp(ECall& c);
+  llvm::Value* genAtomicOp(ECall& c);
+  llvm::Value* genChanOp(ECall& c);
+  llvm::Value* genFileOp(ECall& c);
+  llvm::StructType* arenaType(); // arena: { ptr cur, ptr end, ... }, aurora_arena in the runtime
+  llvm::Value* genArenaOp(ECall& c);
+  llvm::Value* genPoolOp(ECall& c);
+  llvm::Value* genAddr(Expr& e);
+  llvm::Value* genRefAddr(Expr& e);
+  llvm::Value* genValueAs(Expr& e, const Type& to);
+  llvm::StructType* sliceType(); // []T: { ptr data, i64 len }
+  llvm::StructType* vecType();   // vec<T>: { ptr data, i64 len, i64 cap }, aurora_vec in the runtime
+  llvm::Value* genVecOp(ECall& c);
+  llvm::Value* genVecGrow(const Type& vt, llvm::Value* hdr, llvm::Value* need);
+  uint64_t vecRowBytes(const Type& vt);
+
+  // structs: declared fields map to LLVM slots; soa containers keep one column per slot
+  std::unordered_map<std::string, StructDecl*> structDecls;
+  std::unordered_map<std::string, llvm::StructType*> structTypes;
+  std::unordered_map<std::string, std::vector<unsigned>> fieldSlot; // declared index -> slot
+  llvm::StructType* structType(const std::string& name);
+  bool isSoa(const Type& elem);
+  bool soaElement(Expr& e);
+  uint64_t columnOffset(const std::string& name, unsigned slot); // bytes per row before column
+  struct SoaRef { const Type* container; llvm::Value* base; llvm::Value* idx; }; // T[N] addr or vec header
+  SoaRef genSoaRef(EIndex& ix);
+  llvm::Value* soaColumnAddr(const SoaRef& r, unsigned slot, llvm::Type*& colTy);
+  llvm::Value* genSoaLoad(const SoaRef& r);
+  void genSoaStore(const SoaRef& r, llvm::Value* val);
+  llvm::Value* genFieldAddr(EField& f, llvm::Type*& fieldTy);
+  void storeElem(llvm::Value* arr, const Type& arrTy, uint64_t i, llvm::Value* val);
+  llvm::IntegerType* indexType(); // pointer-width GEP index
+  llvm::AllocaInst* entryAlloca(llvm::Type* ty, const llvm::Twine& name);
   void genStmt(Stmt& s, llvm::Function* fn);
-  void runDefers(std::vector<Expr*>& defers);
+  // spawn: a task frame is { runtime header, result, lowered arguments }; <callee>.task runs it
+  llvm::Value* spawnScope = nullptr; // list of tasks the current function spawned
+  std::unordered_map<std::string, llvm::Function*> spawnThunks;
+  llvm::StructType* taskFrame(const std::string& callee);
+  llvm::Function* spawnThunk(const std::string& callee);
+  std::vector<llvm::Value*> genCallArgs(ECall& c);
+  void endSpawnScope(); // before a return: wait for and release the function's tasks
+  // gen fn: a switched-resume coroutine whose ramp returns the handle; yields go through the promise
+  struct GenFrame { llvm::Value *id=nullptr, *hdl=nullptr, *promise=nullptr; llvm::BasicBlock *final=nullptr, *cleanup=nullptr, *suspend=nullptr; };
+  GenFrame gen;
+  std::vector<llvm::Value*> liveGens; // handles of the generators enclosing for loops consume
+  void beginGen(llvm::Function* F);
+  void endGen(llvm::Function* F);
+  void genSuspend(bool final);
+  void destroyLiveGens(); // before leaving the function: release the generators still being consumed
+  void genForGen(SFor& sf, llvm::Function* fn);
+  void genForLoop(SFor& sf, llvm::Value* from, llvm::Value* to, llvm::Function* fn);
+  void genParallelFor(SFor& sf, llvm::Value* from, llvm::Value* to, llvm::Function* fn);
+  void attachLoopHints(const LoopHints& h, llvm::BasicBlock* header, llvm::BasicBlock* preheader, llvm::BasicBlock* firstBody);
+  // defer and unique cleanups of each open block, innermost last; each keeps the bindings in
+  // scope where it was registered, since a later shadowing let would otherwise capture its names
+  struct Deferred {
+    Expr* e;
+    std::unordered_map<std::string, llvm::Value*> values, ivs;
+    std::unordered_map<std::string, llvm::Type*> types;
+  };
+  std::vector<std::vector<Deferred>> deferScopes;
+  void genBlock(std::vector<StmtPtr>& body, llvm::Function* fn); // runs its defers on fallthrough
+  void genStmts(std::vector<StmtPtr>& body, llvm::Function* fn); // drops zero-fill loops after allocations
+  ECall* zeroFillOf(Stmt& s, Stmt& next);
+  ECall* zeroedAlloc = nullptr; // the alloc<T> being generated is zero-filled next: use calloc
+  void pushDefer(Expr& e);
+  void runDefers(size_t depth); // emit the defers of scopes depth.. innermost first, LIFO within each
   llvm::Function* declareBuiltin(const char* name, std::vector<llvm::Type*> params, llvm::Type* ret, bool vararg=false);
   llvm::Type* tyLLVM(const Type& t);
+  llvm::Constant* constLLVM(const ConstValue& v, const Type& t);
+  void fillArray(llvm::Value* arr, llvm::Type* arrTy, llvm::Value* val);
 };
\ No newline at end of file
@@ -0,0 +1,217 @@
+// consteval.cpp
+#include "consteval.h"
+#include "sema.h"
+#include "diagnostics.h"
+#include <cstdint>
+
+static const long long kMaxSteps = 50'000'000; // loop iterations + calls per constant
+static const size_t kMaxDepth = 512;           // const fn recursion depth
+
+static ConstValue mkInt(std::int64_t v){ ConstValue c; c.v=v; return c; }
+static ConstValue mkBool(bool b){ ConstValue c; c.v=b; c.isBool=true; return c; }
+static std::int64_t wrap(std::uint64_t v){ return (std::int64_t)v; }
+
+void ConstEval::tick(){
+  if (++steps > kMaxSteps) fatal("constant evaluation exceeded step limit");
+}
+
+void ConstEval::coerce(ConstValue& v, const Type& t){
+  switch (t.k){
+    case TyKind::I32: v.v = (std::int32_t)v.v; v.isBool=false; break;
+    case TyKind::I64: v.isBool=false; break;
+    case TyKind::Bool: v.v = v.v!=0; v.isBool=true; break;
+    case TyKind::Array:
+      if (!v.isArray || (std::int64_t)v.elems.size()!=t.arraySize)
+        fatal("constant array does not match type "+t.str());
+      for (auto& e : v.elems) coerce(e, *t.elem);
+      break;
+    default: fatal("type "+t.str()+" is not allowed in constant evaluation");
+  }
+}
+
+ConstValue* ConstEval::lookupLocal(const std::string& n){
+  if (frames.empty()) return nullptr;
+  auto& env = frames.back();
+  for (int i=(int)env.size()-1;i>=0;--i){ auto it=env[i].find(n); if (it!=env[i].end()) return &it->second; }
+  return nullptr;
+}
+
+ConstValue ConstEval::eval(Expr& e){
+  if (frames.empty()) steps = 0;
+  return evalExpr(e);
+}
+
+ConstValue* ConstEval::lvalue(Expr& e){
+  if (auto *v = dynamic_cast<EVar*>(&e)){
+    if (auto *c = lookupLocal(v->name)) return c;
+    fatal("cannot assign to '"+v->name+"' in constant evaluation");
+  }
+  if (auto *ix = dynamic_cast<EIndex*>(&e)){
+    auto *arr = lvalue(*ix->arr);
+    auto i = evalExpr(*ix->idx).v;
+    if (!arr->isArray) fatal("indexing a non-array in constant evaluation");
+    if (i<0 || i>=(std::int64_t)arr->elems.size()) fatal("index "+std::to_string(i)+" out of bounds in constant evaluation");
+    return &arr->elems[i];
+  }
+  fatal("invalid assignment target in constant evaluation");
+}
+
+ConstValue ConstEval::evalExpr(Expr& e){
+  if (auto *x = dynamic_cast<EInt*>(&e)) return mkInt(x->v);
+  if (auto *b = dynamic_cast<EBool*>(&e)) return mkBool(b->v);
+  if (auto *v = dynamic_cast<EVar*>(&e)){
+    if (auto *c = lookupLocal(v->name)) return *c;
+    if (auto *c = sema.constValue(v->name)) return *c;
+    fatal("'"+v->name+"' is not a constant");
+  }
+  if (auto *u = dynamic_cast<EUnary*>(&e)){
+    auto r = evalExpr(*u->rhs);
+    if (u->op==TokKind::Minus) return mkInt(wrap(0-(std::uint64_t)r.v));
+    if (r.isBool) return mkBool(!r.v);
+    return mkInt(~r.v);
+  }
+  if (auto *bin = dynamic_cast<EBin*>(&e)){
+    if (bin->op==TokKind::Eq){
+      auto rv = evalExpr(*bin->rhs);
+      auto *dst = lvalue(*bin->lhs);
+      *dst = rv;
+      return rv;
+    }
+    auto a = evalExpr(*bin->lhs);
+    auto b = evalExpr(*bin->rhs);
+    auto ua = (std::uint64_t)a.v, ub = (std::uint64_t)b.v;
+    switch (bin->op){
+      case TokKind::Plus: return mkInt(wrap(ua+ub));
+      case TokKind::Minus: return mkInt(wrap(ua-ub));
+      case TokKind::Star: return mkInt(wrap(ua*ub));
+      case TokKind::Slash:
+      case TokKind::Percent:
+        if (b.v==0) fatal("division by zero in constant evaluation");
+        if (a.v==INT64_MIN && b.v==-1) fatal("overflow in constant division");
+        return mkInt(bin->op==TokKind::Slash ? a.v/b.v : a.v%b.v);
+      case TokKind::EqEq: return mkBool(a.v==b.v);
+      case TokKind::BangEq: return mkBool(a.v!=b.v);
+      case TokKind::Lt: return mkBool(a.v<b.v);
+      case TokKind::Le: return mkBool(a.v<=b.v);
+      case TokKind::Gt: return mkBool(a.v>b.v);
+      case TokKind::Ge: return mkBool(a.v>=b.v);
+      // both sides are evaluated, matching CodeGen's non-short-circuit lowering
+      case TokKind::AmpAmp: { auto r=mkInt(a.v & b.v); r.isBool = a.isBool && b.isBool; return r; }
+      case TokKind::PipePipe: { auto r=mkInt(a.v | b.v); r.isBool = a.isBool && b.isBool; return r; }
+      default: break;
+    }
+    fatal("unsupported operator in constant evaluation");
+  }
+  if (auto *c = dynamic_cast<ECall*>(&e)){
+    auto it = sema.constFns.find(c->callee);
+    if (it==sema.constFns.end()) fatal("call to non-const function '"+c->callee+"' in constant evaluation");
+    std::vector<ConstValue> args;
+    for (auto& a : c->args) args.push_back(evalExpr(*a));
+    return call(*it->second, std::move(args));
+  }
+  if (auto *a = dynamic_cast<EArrayLit*>(&e)){
+    ConstValue r; r.isArray=true;
+    for (auto& el : a->elems) r.elems.push_back(evalExpr(*el));
+    return r;
+  }
+  if (auto *rep = dynamic_cast<EArrayRepeat*>(&e)){
+    auto v = evalExpr(*rep->value);
+    auto n = evalExpr(*rep->count).v;
+    if (n<=0) fatal("array repeat count must be positive");
+    ConstValue r; r.isArray=true;
+    r.elems.assign((size_t)n, v);
+    return r;
+  }
+  if (auto *ix = dynamic_cast<EIndex*>(&e)){
+    auto arr = evalExpr(*ix->arr);
+    auto i = evalExpr(*ix->idx).v;
+    if (!arr.isArray) fatal("indexing a non-array in constant evaluation");
+    if (i<0 || i>=(std::int64_t)arr.elems.size()) fatal("index "+std::to_string(i)+" out of bounds in constant evaluation");
+    return arr.elems[i];
+  }
+  fatal("expression is not allowed in constant evaluation");
+}
+
+ConstValue ConstEval::call(Func& fn, std::vector<ConstValue> args){
+  if (!fn.isConst) fatal("call to non-const function '"+fn.name+"' in constant evaluation");
+  if (args.size()!=fn.params.size()) fatal("wrong number of arguments to "+fn.name);
+  if (frames.size() >= kMaxDepth) fatal("constant evaluation exceeded recursion limit in "+fn.name);
+  tick();
+
+  Env env(1);
+  for (size_t k=0; k<args.size(); ++k){
+    sema.resolveType(*fn.params[k].ty);
+    coerce(args[k], *fn.params[k].ty);
+    env[0][fn.params[k].name] = std::move(args[k]);
+  }
+  frames.push_back(std::move(env));
+  auto flow = execBlock(fn.body);
+  frames.pop_back();
+
+  if (fn.ret->k==TyKind::Void) return ConstValue{};
+  if (flow!=Flow::Return) fatal("const fn '"+fn.name+"' did not return a value");
+  auto r = std::move(retVal);
+  sema.resolveType(*fn.ret);
+  coerce(r, *fn.ret);
+  return r;
+}
+
+ConstEval::Flow ConstEval::execBlock(std::vector<StmtPtr>& body){
+  frames.back().emplace_back();
+  Flow f = Flow::Normal;
+  for (auto& st : body){
+    f = exec(*st);
+    if (f!=Flow::Normal) break;
+  }
+  frames.back().pop_back();
+  return f;
+}
+
+ConstEval::Flow ConstEval::exec(Stmt& s){
+  if (auto *sl = dynamic_cast<SLet*>(&s)){
+    if (sl->isUnique) fatal("unique<T> is not allowed in const fn");
+    auto v = evalExpr(*sl->init);
+    if (sl->annType){ sema.resolveType(*sl->annType); coerce(v, *sl->annType); }
+    frames.back().back()[sl->name] = std::move(v);
+    return Flow::Normal;
+  }
+  if (auto *se = dynamic_cast<SExpr*>(&s)){ (void)evalExpr(*se->e); return Flow::Normal; }
+  if (auto *sr = dynamic_cast<SReturn*>(&s)){
+    retVal = sr->e ? evalExpr(*sr->e) : ConstValue{};
+    return Flow::Return;
+  }
+  if (auto *si = dynamic_cast<SIf*>(&s)){
+    return evalExpr(*si->cond).v ? execBlock(si->thenStmts) : execBlock(si->elseStmts);
+  }
+  if (auto *sw = dynamic_cast<SWhile*>(&s)){
+    while (evalExpr(*sw->cond).v){
+      tick();
+      auto f = execBlock(sw->body);
+      if (f==Flow::Break) break;
+      if (f==Flow::Return) return f;
+    }
+    return Flow::Normal;
+  }
+  if (auto *sf = dynamic_cast<SFor*>(&s)){
+    auto to = evalExpr(*sf->to).v;
+    // folded here, not read from stepValue: a const can call a const fn Sema has not checked yet
+    std::int64_t step = sf->step ? evalExpr(*sf->step).v : 1;
+    if (step<=0) fatal("for step must be a positive constant");
+    for (auto i = evalExpr(*sf->from).v; i < to; ){
+      tick();
+      frames.back().emplace_back();
+      frames.back().back()[sf->var] = mkInt(i);
+      Flow f = Flow::Normal;
+      for (auto& st : sf->body){ f = exec(*st); if (f!=Flow::Normal) break; }
+      frames.back().pop_back();
+      if (f==Flow::Break) break;
+      if (f==Flow::Return) return f;
+      if (__builtin_add_overflow(i, step, &i)) break;
+    }
+    return Flow::Normal;
+  }
+  if (dynamic_cast<SDefer*>(&s)) fatal("defer is not allowed in const fn");
+  if (dynamic_cast<SBreak*>(&s)) return Flow::Break;
+  if (dynamic_cast<SContinue*>(&s)) return Flow::Continue;
+  fatal("statement is not allowed in constant evaluation");
+}
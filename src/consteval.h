@@ -0,0 +1,31 @@
+// consteval.h
+#pragma once
+#include "ast.h"
+#include "types.h"
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct Sema;
+
+// AST interpreter for `const` initializers and `const fn` bodies.
+struct ConstEval {
+  Sema& sema;
+  explicit ConstEval(Sema& s):sema(s){}
+  ConstValue eval(Expr& e);
+  ConstValue call(Func& fn, std::vector<ConstValue> args);
+  void coerce(ConstValue& v, const Type& t); // truncate/normalize to a declared type
+private:
+  enum class Flow { Normal, Break, Continue, Return };
+  using Env = std::vector<std::unordered_map<std::string, ConstValue>>;
+  std::vector<Env> frames; // one Env per active const fn call
+  ConstValue retVal;
+  long long steps = 0;
+
+  ConstValue evalExpr(Expr& e);
+  ConstValue* lvalue(Expr& e);
+  ConstValue* lookupLocal(const std::string& n);
+  Flow exec(Stmt& s);
+  Flow execBlock(std::vector<StmtPtr>& body);
+  void tick();
+};
@@ -1,5 +1,6 @@
 // lexer.cpp
 #include "lexer.h"
+#include "diagnostics.h"
 #include <cctype>
 
 char Lexer::get(){ char c=peek(); if(c=='\0') return c; ++i; if(c=='\n'){++line; col=1;} else ++col; return c; }
@@ -19,10 +20,14 @@ Token Lexer::identOrKw(){
   while (std::isalnum((unsigned char)peek()) || peek()=='_') s.push_back(get());
   TokKind k = TokKind::Ident;
   if (s=="let") k=TokKind::KwLet;
+  else if (s=="const") k=TokKind::KwConst;
   else if (s=="fn") k=TokKind::KwFn;
+  else if (s=="export") k=TokKind::KwExport;
+  else if (s=="struct") k=TokKind::KwStruct;
   else if (s=="if") k=TokKind::KwIf;
   else if (s=="else") k=TokKind::KwElse;
   else if (s=="while") k=TokKind::KwWhile;
+  else if (s=="for") k=TokKind::KwFor;
   else if (s=="return") k=TokKind::KwReturn;
   else if (s=="defer") k=TokKind::KwDefer;
   else if (s=="break") k=TokKind::KwBreak;
@@ -44,6 +49,25 @@ Token Lexer::number(){
   return Token{TokKind::IntLit,s,std::stoll(s),L,C};
 }
 
+// "..." with \\ \" \n \t escapes; the lexeme holds the decoded bytes
+Token Lexer::string(){
+  int L=line,C=col; std::string s;
+  get(); // '"'
+  for(;;){
+    char c=get();
+    if (c=='\0' || c=='\n') fatal("unterminated string literal at line "+std::to_string(L));
+    if (c=='"') break;
+    if (c=='\\'){
+      char e=get();
+      if (e=='n') c='\n'; else if (e=='t') c='\t';
+      else if (e=='\\' || e=='"') c=e;
+      else fatal(std::string("unknown escape \\")+e+" in string literal at line "+std::to_string(L));
+    }
+    s.push_back(c);
+  }
+  return Token{TokKind::StrLit,s,0,L,C};
+}
+
 std::vector<Token> Lexer::lex(){
   std::vector<Token> v;
   for(;;){
@@ -53,6 +77,7 @@ std::vector<Token> Lexer::lex(){
     if (!c){ v.push_back(Token{TokKind::Eof,"",0,L,C}); break; }
     if (std::isalpha((unsigned char)c) || c=='_') { v.push_back(identOrKw()); continue; }
     if (std::isdigit((unsigned char)c)) { v.push_back(number()); continue; }
+    if (c=='"') { v.push_back(string()); continue; }
     auto two=[&](TokKind k)->void{ get(); get(); v.push_back(Token{k,"",0,L,C}); };
     auto one=[&](TokKind k)->void{ get(); v.push_back(Token{k,"",0,L,C}); };
     if (c=='(') { one(TokKind::LParen); continue; }
@@ -64,6 +89,8 @@ std::vector<Token> Lexer::lex(){
     if (c==',') { one(TokKind::Comma); continue; }
     if (c==':') { one(TokKind::Colon); continue; }
     if (c==';') { one(TokKind::Semicolon); continue; }
+    if (c=='.') { if (i+1<src.size() && src[i+1]=='.') two(TokKind::DotDot); else one(TokKind::Dot); continue; }
+    if (c=='#') { one(TokKind::Hash); continue; }
     if (c=='+' ) { if (i+1<src.size() && src[i+1]=='=') two(TokKind::PlusEq); else one(TokKind::Plus); continue; }
     if (c=='-' ){ if (i+1<src.size() && src[i+1]=='>') { two(TokKind::Arrow); } else if (i+1<src.size() && src[i+1]=='=') two(TokKind::MinusEq); else one(TokKind::Minus); continue; }
     if (c=='*' ) { if (i+1<src.size() && src[i+1]=='=') two(TokKind::StarEq); else one(TokKind::Star); continue; }
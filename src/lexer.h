@@ -17,4 +17,5 @@ private:
   void skipWS();
   Token identOrKw();
   Token number();
+  Token string();
 };
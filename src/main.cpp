@@ -10,15 +10,25 @@
 
 int main(int argc, char** argv){
   if (argc < 3){
-    std::cerr << "usage: aurorac <input.aur> -o <out.o> [--emit-ll out.ll]\n";
+    std::cerr << "usage: aurorac <input.aur> -o <out.o> [--emit-ll out.ll] [-O0|-O1|-O2|-O3] [--no-whole-program] [--cpu <name|native>] [--remarks] [--alloc-profile]\n";
     return 1;
   }
   std::string in = argv[1];
   std::string outObj, outLL;
+  int optLevel = 2;
+  bool wholeProgram = true;
+  std::string cpu = "generic";
+  bool remarks = false;
+  bool allocProfile = false;
   for (int i=2;i<argc;i++){
     std::string a = argv[i];
     if (a=="-o" && i+1<argc) outObj = argv[++i];
     else if (a=="--emit-ll" && i+1<argc) outLL = argv[++i];
+    else if (a=="--no-whole-program") wholeProgram = false;
+    else if (a=="--cpu" && i+1<argc) cpu = argv[++i];
+    else if (a=="--remarks") remarks = true;
+    else if (a=="--alloc-profile") allocProfile = true;
+    else if (a.size()==3 && a[0]=='-' && a[1]=='O' && a[2]>='0' && a[2]<='3') optLevel = a[2]-'0';
   }
   if (outObj.empty()) fatal("missing -o <file.o>");
 
@@ -29,8 +39,12 @@ int main(int argc, char** argv){
   auto prog = ps.parseProgram();
 
   Sema sema; sema.analyze(*prog);
-  CodeGen cg("aurora_module");
+  CodeGen cg("aurora_module", cpu);
+  cg.wholeProgram = wholeProgram;
+  cg.remarks = remarks;
+  cg.allocProfile = allocProfile;
   cg.emit(*prog);
+  cg.optimize(optLevel);
   if (!outLL.empty()) cg.writeIR(outLL);
   cg.writeObject(outObj);
   return 0;
@@ -1,17 +1,63 @@
 // parser.cpp
 #include "parser.h"
 #include "diagnostics.h"
+#include <unordered_set>
+
+// Builtins that take explicit type arguments: name<T,...>(args)
+static bool isGenericBuiltin(const std::string& n){
+  static const std::unordered_set<std::string> names = {"alloc", "alloc_zeroed", "alloc_large", "vec", "atomic", "chan", "spsc_chan", "map_array", "arena_alloc", "pool_alloc"};
+  return names.count(n) > 0;
+}
 
 void Parser::expect(TokKind k, const char* msg){
   if (!accept(k)) fatal(std::string("expected ")+msg);
 }
 
+std::unique_ptr<Type> Parser::parseSimdArgs(){
+  auto elem = parseType();
+  expect(TokKind::Comma, "','");
+  auto t = Type::simd(std::move(elem), 0);
+  if (peek().kind==TokKind::IntLit && peek(1).kind==TokKind::Gt) t->arraySize = get().intValue;
+  else t->sizeExpr = parseAdd(); // constant lane count; stops before '>'
+  expect(TokKind::Gt, "'>'");
+  return t;
+}
+
 std::unique_ptr<Type> Parser::parseType(){
   std::unique_ptr<Type> baseType;
   if (accept(TokKind::KwI32)) baseType = Type::i32();
   else if (accept(TokKind::KwI64)) baseType = Type::i64();
   else if (accept(TokKind::KwBool)) baseType = Type::boolean();
   else if (accept(TokKind::KwVoid)) baseType = Type::voidty();
+  else if (accept(TokKind::LBracket)) {
+    // slice []T
+    expect(TokKind::RBracket, "']'");
+    return Type::slice(parseType());
+  }
+  else if (peek().kind==TokKind::Ident && peek().lexeme=="simd" && peek(1).kind==TokKind::Lt) {
+    get(); get(); // 'simd' '<'
+    baseType = parseSimdArgs();
+  }
+  else if (peek().kind==TokKind::Ident && peek().lexeme=="vec" && peek(1).kind==TokKind::Lt) {
+    get(); get(); // 'vec' '<'
+    auto t=parseType();
+    expect(TokKind::Gt, "'>'");
+    baseType = Type::vec(std::move(t));
+  }
+  else if (peek().kind==TokKind::Ident && peek().lexeme=="atomic" && peek(1).kind==TokKind::Lt) {
+    get(); get(); // 'atomic' '<'
+    auto t=parseType();
+    expect(TokKind::Gt, "'>'");
+    baseType = Type::atomic(std::move(t));
+  }
+  else if (peek().kind==TokKind::Ident && peek().lexeme=="chan" && peek(1).kind==TokKind::Lt) {
+    get(); get(); // 'chan' '<'
+    auto t=parseType();
+    expect(TokKind::Gt, "'>'");
+    baseType = Type::chan(std::move(t));
+  }
+  else if (peek().kind==TokKind::Ident && peek().lexeme=="arena") { get(); baseType = Type::arena(); }
+  else if (peek().kind==TokKind::Ident) baseType = Type::structTy(get().lexeme);
   else if (accept(TokKind::KwPtr)) {
     expect(TokKind::Lt, "'<'");
     auto t=parseType();
@@ -23,10 +69,16 @@ std::unique_ptr<Type> Parser::parseType(){
   // Check for array syntax T[size]
   if (peek().kind == TokKind::LBracket) {
     get(); // consume '['
-    if (peek().kind != TokKind::IntLit) fatal("expected integer size for array");
-    int64_t size = get().intValue;
+    if (peek().kind == TokKind::IntLit && peek(1).kind == TokKind::RBracket) {
+      int64_t size = get().intValue;
+      get(); // consume ']'
+      return Type::array(std::move(baseType), size);
+    }
+    // Constant expression size (e.g. T[N]); Sema folds it into arraySize
+    auto arr = Type::array(std::move(baseType), 0);
+    arr->sizeExpr = parseExpr();
     expect(TokKind::RBracket, "']'");
-    return Type::array(std::move(baseType), size);
+    return arr;
   }
   
   return baseType;
@@ -42,7 +94,33 @@ std::vector<StmtPtr> Parser::parseBlock(){
   return stmts;
 }
 
+LoopHints Parser::loopHints(const std::vector<Attr>& attrs){
+  LoopHints h;
+  auto count = [](const Attr& a, const char* key) -> int {
+    if (a.args.size()!=1 || (!a.args[0].first.empty() && a.args[0].first!=key) || a.args[0].second<1)
+      fatal("#["+a.name+"] expects a positive "+key);
+    return (int)a.args[0].second;
+  };
+  for (auto& a : attrs){
+    if (a.name=="vectorize"){ h.vectorize = true; if (!a.args.empty()) h.vectorizeWidth = count(a, "width"); }
+    else if (a.name=="unroll") h.unroll = count(a, "count");
+    else if (a.name=="interleave") h.interleave = count(a, "count");
+    else if (a.name=="independent"){ if (!a.args.empty()) fatal("#[independent] takes no arguments"); h.independent = true; }
+    else fatal("unknown loop attribute '"+a.name+"'");
+  }
+  return h;
+}
+
 StmtPtr Parser::parseStmt(){
+  if (peek().kind==TokKind::Hash){
+    auto attrs = parseAttrs();
+    bool par = peek().kind==TokKind::Ident && peek().lexeme=="parallel" && peek(1).kind==TokKind::KwFor;
+    if (peek().kind!=TokKind::KwWhile && peek().kind!=TokKind::KwFor && !par) fatal("attributes must precede a loop");
+    auto s = parseStmt();
+    if (auto *sw = dynamic_cast<SWhile*>(s.get())) sw->hints = loopHints(attrs);
+    else static_cast<SFor*>(s.get())->hints = loopHints(attrs);
+    return s;
+  }
   if (accept(TokKind::KwLet)){
     bool isUnique=false;
     if (accept(TokKind::KwUnique)) { expect(TokKind::Lt,"'<'"); parseType(); expect(TokKind::Gt,"'>'"); isUnique=true; }
@@ -77,6 +155,45 @@ StmtPtr Parser::parseStmt(){
     s->body = parseBlock();
     return s;
   }
+  if (peek().kind==TokKind::Ident && peek().lexeme=="parallel" && peek(1).kind==TokKind::KwFor){
+    get();
+    auto s = parseStmt();
+    static_cast<SFor*>(s.get())->parallel = true;
+    return s;
+  }
+  if (accept(TokKind::KwFor)){
+    auto s = std::make_unique<SFor>();
+    if (peek().kind!=TokKind::Ident) fatal("expected loop variable after 'for'");
+    s->var = get().lexeme;
+    if (peek().kind!=TokKind::Ident || peek().lexeme!="in") fatal("expected 'in' after loop variable");
+    get();
+    noStructLit = true;
+    s->from = parseExpr();
+    if (accept(TokKind::DotDot)){
+      s->to = parseExpr();
+      if (peek().kind==TokKind::Ident && peek().lexeme=="step"){ get(); s->step = parseExpr(); }
+    } else {
+      s->gen = std::move(s->from); // for x in g(args): consumes a generator
+    }
+    noStructLit = false;
+    if (peek().kind==TokKind::Ident && peek().lexeme=="reduce" && peek(1).kind==TokKind::LParen){
+      get(); get();
+      do {
+        Reduction r;
+        if (accept(TokKind::Plus)) r.op = "+";
+        else if (accept(TokKind::Star)) r.op = "*";
+        else if (peek().kind==TokKind::Ident && (peek().lexeme=="min" || peek().lexeme=="max")) r.op = get().lexeme;
+        else fatal("expected reduction operator (+, *, min or max)");
+        expect(TokKind::Colon,"':'");
+        if (peek().kind!=TokKind::Ident) fatal("expected reduction variable");
+        r.var = get().lexeme;
+        s->reductions.push_back(r);
+      } while (accept(TokKind::Comma));
+      expect(TokKind::RParen,"')'");
+    }
+    s->body = parseBlock();
+    return s;
+  }
   if (accept(TokKind::KwDefer)){
     auto e=parseExpr();
     expect(TokKind::Semicolon,"';'");
@@ -90,6 +207,16 @@ StmtPtr Parser::parseStmt(){
     expect(TokKind::Semicolon,"';'");
     return std::make_unique<SContinue>();
   }
+  if (inGen && peek().kind==TokKind::Ident && peek().lexeme=="yield"){
+    get();
+    auto e = parseExpr();
+    expect(TokKind::Semicolon,"';'");
+    return std::make_unique<SYield>(std::move(e));
+  }
+  if (peek().kind==TokKind::Ident && peek().lexeme=="sync" && peek(1).kind==TokKind::Semicolon){
+    get(); get();
+    return std::make_unique<SSync>();
+  }
   // expr;
   auto e = parseExpr();
   expect(TokKind::Semicolon,"';'");
@@ -195,12 +322,50 @@ ExprPtr Parser::parseUnary(){
 }
 ExprPtr Parser::parsePostfix(){
   ExprPtr e;
-  
+  if (peek().kind==TokKind::Ident && peek().lexeme=="spawn" && peek(1).kind==TokKind::Ident && peek(2).kind==TokKind::LParen){
+    get();
+    auto call = parsePostfix();
+    if (!dynamic_cast<ECall*>(call.get())) fatal("spawn expects a function call");
+    return std::make_unique<ESpawn>(std::move(call));
+  }
+
   // Parse primary expression
   if (peek().kind==TokKind::Ident){
+    int line = peek().line;
     auto id = get().lexeme;
-    if (accept(TokKind::LParen)){
+    std::vector<std::unique_ptr<Type>> typeArgs;
+    // simd<T,N>(x...), splat<T,N>(x), load<T,N>(src, i): the lane shape is the type argument
+    bool simdArgs = (id=="simd" || id=="splat" || id=="load") && peek().kind==TokKind::Lt &&
+      (peek(1).kind==TokKind::KwI32 || peek(1).kind==TokKind::KwI64 || peek(1).kind==TokKind::KwBool);
+    if (simdArgs){
+      get(); // '<'
+      typeArgs.push_back(parseSimdArgs());
+      if (peek().kind!=TokKind::LParen) fatal("expected '(' after "+id+"<...>");
+    } else if (isGenericBuiltin(id) && accept(TokKind::Lt)){
+      typeArgs.push_back(parseType());
+      while (accept(TokKind::Comma)) typeArgs.push_back(parseType());
+      expect(TokKind::Gt, "'>'");
+      if (peek().kind!=TokKind::LParen) fatal("expected '(' after "+id+"<...>");
+    }
+    // struct literal: Name { field: e, ... } (Name {} zero-initializes)
+    bool structLit = !noStructLit && typeArgs.empty() && peek().kind==TokKind::LBrace &&
+      (peek(1).kind==TokKind::RBrace || (peek(1).kind==TokKind::Ident && peek(2).kind==TokKind::Colon));
+    if (structLit){
+      get(); // '{'
+      auto lit = std::make_unique<EStruct>(id);
+      while (peek().kind!=TokKind::RBrace){
+        if (peek().kind!=TokKind::Ident) fatal("expected field name in "+id+" literal");
+        auto field = get().lexeme;
+        expect(TokKind::Colon,"':'");
+        lit->inits.emplace_back(field, parseExpr());
+        if (!accept(TokKind::Comma)) break;
+      }
+      expect(TokKind::RBrace,"'}'");
+      e = std::move(lit);
+    } else if (accept(TokKind::LParen)){
       auto call = std::make_unique<ECall>(id);
+      call->typeArgs = std::move(typeArgs);
+      call->line = line;
       if (peek().kind!=TokKind::RParen){
         call->args.push_back(parseExpr());
         while (accept(TokKind::Comma)) call->args.push_back(parseExpr());
@@ -212,32 +377,103 @@ ExprPtr Parser::parsePostfix(){
     }
   }
   else if (peek().kind==TokKind::IntLit){ auto v=get().intValue; e = std::make_unique<EInt>(v); }
+  else if (peek().kind==TokKind::StrLit){ e = std::make_unique<EStr>(get().lexeme); }
   else if (accept(TokKind::True)) e = std::make_unique<EBool>(true);
   else if (accept(TokKind::False)) e = std::make_unique<EBool>(false);
   else if (accept(TokKind::LBracket)){
-    // Array literal [e1, e2, ...]
+    // Array literal [e1, e2, ...] or repeat literal [value; count]
     std::vector<ExprPtr> elems;
     if (peek().kind != TokKind::RBracket){
       elems.push_back(parseExpr());  
-      while (accept(TokKind::Comma)) elems.push_back(parseExpr());
+      if (accept(TokKind::Semicolon)){
+        auto count = parseExpr();
+        expect(TokKind::RBracket,"']'");
+        e = std::make_unique<EArrayRepeat>(std::move(elems[0]), std::move(count));
+      } else {
+        while (accept(TokKind::Comma)) elems.push_back(parseExpr());
+      }
+    }
+    if (!e){
+      expect(TokKind::RBracket,"']'");
+      e = std::make_unique<EArrayLit>(std::move(elems));
     }
-    expect(TokKind::RBracket,"']'");
-    e = std::make_unique<EArrayLit>(std::move(elems));
   }
   else if (accept(TokKind::LParen)){ e=parseExpr(); expect(TokKind::RParen,"')'"); }
   else fatal("expected expression");
   
-  // Parse postfix operations (array indexing)
-  while (peek().kind == TokKind::LBracket) {
-    get(); // consume '['
-    auto idx = parseExpr();
-    expect(TokKind::RBracket, "']'");
-    e = std::make_unique<EIndex>(std::move(e), std::move(idx));
+  // Parse postfix operations (array indexing, field access)
+  for (;;) {
+    if (accept(TokKind::LBracket)) {
+      auto idx = parseExpr();
+      expect(TokKind::RBracket, "']'");
+      e = std::make_unique<EIndex>(std::move(e), std::move(idx));
+    } else if (accept(TokKind::Dot)) {
+      if (peek().kind!=TokKind::Ident) fatal("expected field name after '.'");
+      e = std::make_unique<EField>(std::move(e), get().lexeme);
+    } else break;
   }
   
   return e;
 }
 
+std::unique_ptr<ConstDecl> Parser::parseConst(){
+  if (peek().kind!=TokKind::Ident) fatal("expected identifier after 'const'");
+  auto c = std::make_unique<ConstDecl>();
+  c->name = get().lexeme;
+  if (accept(TokKind::Colon)) c->ty = parseType();
+  expect(TokKind::Eq,"'='");
+  c->init = parseExpr();
+  expect(TokKind::Semicolon,"';'");
+  return c;
+}
+
+std::vector<Attr> Parser::parseAttrs(){
+  std::vector<Attr> attrs;
+  while (accept(TokKind::Hash)){
+    expect(TokKind::LBracket,"'['");
+    do {
+      if (peek().kind!=TokKind::Ident) fatal("expected attribute name");
+      Attr a; a.name = get().lexeme;
+      if (accept(TokKind::LParen)){
+        while (peek().kind!=TokKind::RParen){
+          std::string key;
+          if (peek().kind==TokKind::Ident){ key = get().lexeme; expect(TokKind::Eq,"'='"); }
+          if (peek().kind!=TokKind::IntLit) fatal("attribute "+a.name+" expects integer arguments");
+          a.args.emplace_back(key, get().intValue);
+          if (!accept(TokKind::Comma)) break;
+        }
+        expect(TokKind::RParen,"')'");
+      }
+      attrs.push_back(std::move(a));
+    } while (accept(TokKind::Comma));
+    expect(TokKind::RBracket,"']'");
+  }
+  return attrs;
+}
+
+std::unique_ptr<StructDecl> Parser::parseStruct(const std::vector<Attr>& attrs){
+  expect(TokKind::KwStruct,"'struct'");
+  if (peek().kind!=TokKind::Ident) fatal("expected struct name");
+  auto s = std::make_unique<StructDecl>();
+  s->name = get().lexeme;
+  for (auto& a : attrs){
+    if (a.name=="keep_order") s->keepOrder = true;
+    else if (a.name=="soa") s->soa = true;
+    else fatal("unknown struct attribute '"+a.name+"'");
+  }
+  expect(TokKind::LBrace,"'{'");
+  while (peek().kind!=TokKind::RBrace){
+    if (peek().kind!=TokKind::Ident) fatal("expected field name in struct "+s->name);
+    Param f; f.name = get().lexeme;
+    expect(TokKind::Colon,"':'");
+    f.ty = parseType();
+    s->fields.push_back(std::move(f));
+    if (!accept(TokKind::Comma)) break;
+  }
+  expect(TokKind::RBrace,"'}'");
+  return s;
+}
+
 std::unique_ptr<Func> Parser::parseFunc(){
   expect(TokKind::KwFn,"'fn'");
   if (peek().kind!=TokKind::Ident) fatal("expected function name");
@@ -270,6 +506,34 @@ std::unique_ptr<Func> Parser::parseFunc(){
 std::unique_ptr<Program> Parser::parseProgram(){
   auto p = std::make_unique<Program>();
   while (peek().kind!=TokKind::Eof){
+    auto attrs = parseAttrs();
+    if (peek().kind==TokKind::KwStruct){ p->structs.push_back(parseStruct(attrs)); continue; }
+    if (!attrs.empty()) fatal("attributes are only allowed on struct declarations");
+    if (accept(TokKind::KwExport)){
+      bool isConst = accept(TokKind::KwConst);
+      if (peek().kind!=TokKind::KwFn) fatal("expected 'fn' after 'export'");
+      p->funcs.push_back(parseFunc());
+      p->funcs.back()->isConst = isConst;
+      p->funcs.back()->isExport = true;
+      continue;
+    }
+    if (accept(TokKind::KwConst)){
+      if (peek().kind==TokKind::KwFn){
+        p->funcs.push_back(parseFunc());
+        p->funcs.back()->isConst = true;
+      } else {
+        p->consts.push_back(parseConst());
+      }
+      continue;
+    }
+    if (peek().kind==TokKind::Ident && peek().lexeme=="gen" && peek(1).kind==TokKind::KwFn){
+      get();
+      inGen = true;
+      p->funcs.push_back(parseFunc());
+      p->funcs.back()->isGen = true;
+      inGen = false;
+      continue;
+    }
     p->funcs.push_back(parseFunc());
   }
   return p;
@@ -8,16 +8,23 @@
 class Parser {
   const std::vector<Token> toks;
   size_t i=0;
+  bool noStructLit=false; // in a for header, `n {` starts the loop body
+  bool inGen=false;       // parsing a gen fn body, where `yield` is a statement
 public:
   explicit Parser(std::vector<Token> t):toks(std::move(t)){}
   std::unique_ptr<Program> parseProgram();
 private:
-  const Token& peek() const { return toks[i]; }
+  const Token& peek(size_t n=0) const { return toks[i+n<toks.size()? i+n : toks.size()-1]; }
   const Token& get(){ return toks[i++]; }
   bool accept(TokKind k){ if (peek().kind==k){ ++i; return true; } return false; }
   void expect(TokKind k, const char* msg);
   std::unique_ptr<Func> parseFunc();
+  std::unique_ptr<ConstDecl> parseConst();
+  std::unique_ptr<StructDecl> parseStruct(const std::vector<Attr>& attrs);
+  std::vector<Attr> parseAttrs();
+  LoopHints loopHints(const std::vector<Attr>& attrs);
   std::unique_ptr<Type> parseType();
+  std::unique_ptr<Type> parseSimdArgs(); // T, N> of simd<T, N>
   std::vector<StmtPtr> parseBlock();
   StmtPtr parseStmt();
   ExprPtr parseExpr();
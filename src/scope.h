@@ -5,21 +5,35 @@
 #include <memory>
 #include "types.h"
 
-struct VarInfo { std::unique_ptr<Type> ty; bool isUnique=false; };
+struct SLet;
+
+struct VarInfo {
+  std::unique_ptr<Type> ty; bool isUnique=false;
+  bool isRef=false;      // array parameter: aliases caller memory
+  bool readOnly=false;   // for-loop variable
+  SLet* let=nullptr;     // unique allocation still eligible for a stack slot
+  std::string origin;    // builtin allocator of the pointer held, while Sema can tell; else empty
+  int originLoop=0;      // loop depth origin was set at; inside a deeper loop a later store may come first
+};
 
 struct Scope {
   std::vector<std::unordered_map<std::string,VarInfo>> stack;
   Scope(){ push(); }
   void push(){ stack.emplace_back(); }
   void pop(){ stack.pop_back(); }
-  bool declare(const std::string& n, std::unique_ptr<Type> t, bool isUnique=false){
+  bool declare(const std::string& n, std::unique_ptr<Type> t, bool isUnique=false, bool isRef=false, bool readOnly=false){
     auto &m = stack.back();
     if (m.count(n)) return false;
-    m.emplace(n, VarInfo{std::move(t),isUnique});
+    m.emplace(n, VarInfo{std::move(t),isUnique,isRef,readOnly});
     return true;
   }
+  int depthOf(const std::string& n) const { // index of the scope declaring n, or -1
+    for (int i=(int)stack.size()-1;i>=0;--i) if (stack[i].count(n)) return i;
+    return -1;
+  }
   const VarInfo* lookup(const std::string& n) const {
     for (int i=(int)stack.size()-1;i>=0;--i){ auto it=stack[i].find(n); if (it!=stack[i].end()) return &it->second; }
     return nullptr;
   }
+  VarInfo* lookup(const std::string& n){ return const_cast<VarInfo*>(static_cast<const Scope*>(this)->lookup(n)); }
 };
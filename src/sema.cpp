@@ -2,6 +2,8 @@
 #include "sema.h"
 #include "diagnostics.h"
 #include <string>  
+#include <unordered_set>
+#include <algorithm>
 
 
 static inline bool isVoid(const Type& t) { return t.k == TyKind::Void; }
@@ -9,6 +11,544 @@ static inline void requireNonVoid(const Type& t, const char* where) {
   if (isVoid(t)) fatal(std::string("void value not allowed in ") + where);
 }
 
+// Operands and conditions: an atomic is only read and written through its builtins.
+static inline void requireValue(const Type& t, const char* where) {
+  requireNonVoid(t, where);
+  if (t.k == TyKind::Atomic) fatal(std::string("atomic value not allowed in ") + where + "; read it with load(a)");
+}
+
+static inline bool isInt(const Type& t) { return t.k == TyKind::I32 || t.k == TyKind::I64; }
+
+// A vec header owns its buffer, so naming one where a value is expected would duplicate ownership;
+// so would copying a struct or array with a vec somewhere inside.
+void Sema::rejectVecCopy(Expr& e, const Type& t){
+  if (t.k==TyKind::Vec && (dynamic_cast<EVar*>(&e) || dynamic_cast<EIndex*>(&e)))
+    fatal("vec<T> cannot be copied; pass it to a function or take a slice");
+  if ((t.k==TyKind::Struct || t.k==TyKind::Array) && hasVec(t) &&
+      (dynamic_cast<EVar*>(&e) || dynamic_cast<EIndex*>(&e) || dynamic_cast<EField*>(&e)))
+    fatal(t.str()+" holds a vec<T> and cannot be copied; use it in place or through a pointer");
+  if (t.k==TyKind::Future && dynamic_cast<EVar*>(&e))
+    fatal("future<T> cannot be copied; join it where it was spawned");
+  if (t.k==TyKind::Atomic && (dynamic_cast<EVar*>(&e) || dynamic_cast<EIndex*>(&e) || dynamic_cast<EField*>(&e)))
+    fatal("atomic<T> cannot be copied; read it with load(a)");
+}
+
+// Integer literals (and scalar constants) take the integer type their context asks for.
+static bool isIntLiteral(Expr& e){
+  if (dynamic_cast<EInt*>(&e)) return true;
+  if (auto *u = dynamic_cast<EUnary*>(&e)) return u->op==TokKind::Minus && isIntLiteral(*u->rhs);
+  return false;
+}
+static void retype(Expr& e, const Type& t){
+  e.ty = t.clone();
+  if (auto *u = dynamic_cast<EUnary*>(&e)) retype(*u->rhs, t);
+}
+
+// Integer widths are interchangeable for constants: the value is already coerced to the declared type.
+static bool constCompatible(const Type& a, const Type& b){
+  if (isInt(a) && isInt(b)) return true;
+  if (a.k==TyKind::Array && b.k==TyKind::Array)
+    return a.arraySize==b.arraySize && constCompatible(*a.elem, *b.elem);
+  return a.equals(b);
+}
+
+bool Sema::throughRef(Expr& base){
+  auto& t = *base.ty;
+  if (t.k==TyKind::Ptr || t.k==TyKind::Slice || t.k==TyKind::Vec) return true;
+  if (auto *ix = dynamic_cast<EIndex*>(&base)) return throughRef(*ix->arr);
+  if (auto *f = dynamic_cast<EField*>(&base)) return throughRef(*f->base);
+  if (auto *v = dynamic_cast<EVar*>(&base)){ auto vi = scope.lookup(v->name); return vi && vi->isRef; }
+  return false;
+}
+
+// Local arrays are only reachable through their name, so two arguments naming different
+// locals cannot overlap. Constant tables are copied at the call, so each is fresh storage.
+const void* Sema::refRoot(Expr& arg){
+  if (arg.ty->k!=TyKind::Array) return nullptr;
+  if (auto *v = dynamic_cast<EVar*>(&arg)){
+    auto vi = scope.lookup(v->name);
+    if (vi) return vi->isRef ? nullptr : vi;
+    return &arg;
+  }
+  if (dynamic_cast<EArrayLit*>(&arg) || dynamic_cast<EArrayRepeat*>(&arg)) return &arg;
+  return nullptr;
+}
+
+// A local declared outside a parallel for is captured by reference into its outlined body.
+void Sema::noteCapture(const std::string& name){
+  int d = scope.depthOf(name);
+  for (auto& p : parallel){
+    if (d >= p.depth) continue;
+    auto& caps = p.loop->captures;
+    if (std::find(caps.begin(), caps.end(), name)!=caps.end()) continue;
+    caps.push_back(name);
+    if (hasAtomic(*scope.lookup(name)->ty)) p.loop->atomicCaptures.push_back(name);
+  }
+}
+
+bool Sema::hasAtomic(const Type& t){
+  if (t.k==TyKind::Atomic) return true;
+  if (t.k==TyKind::Array) return hasAtomic(*t.elem);
+  if (t.k!=TyKind::Struct) return false;
+  for (auto& f : structs.at(t.name)->fields) if (hasAtomic(*f.ty)) return true;
+  return false;
+}
+
+bool Sema::hasVec(const Type& t){
+  if (t.k==TyKind::Vec) return true;
+  if (t.k==TyKind::Array) return hasVec(*t.elem);
+  if (t.k!=TyKind::Struct) return false;
+  for (auto& f : structs.at(t.name)->fields) if (hasVec(*f.ty)) return true;
+  return false;
+}
+
+static const char* orderName(MemOrder o){
+  static const char* names[] = {"relaxed", "acquire", "release", "acq_rel", "seq_cst"};
+  return names[(int)o];
+}
+
+// Atomic builtins: atomic<T>(v), load/store, fetch_<op>, exchange and cas on an atomic<T> place,
+// each with optional orderings (default seq_cst); null when c is not one of them.
+std::unique_ptr<Type> Sema::inferAtomicOp(ECall& c){
+  static const std::unordered_set<std::string> ops = {"atomic", "load", "store", "exchange", "cas",
+    "fetch_add", "fetch_sub", "fetch_and", "fetch_or", "fetch_xor", "fetch_min", "fetch_max"};
+  if (!ops.count(c.callee) || fns.count(c.callee)) return nullptr;
+  if (c.callee=="atomic"){
+    if (c.typeArgs.size()!=1 || c.args.size()!=1) fatal("atomic expects atomic<T>(value)");
+    resolveType(*c.typeArgs[0]);
+    auto t = Type::atomic(c.typeArgs[0]->clone());
+    resolveType(*t);
+    auto vt = infer(*c.args[0]);
+    if (!coerce(*c.args[0], *vt, *t->elem)) fatal("cannot initialize "+t->str()+" with "+vt->str());
+    return t;
+  }
+  if (c.args.empty()) return nullptr;
+  if (c.callee=="load" || c.callee=="store"){
+    // load<T,N>/store(dst, i, v) are the simd forms
+    if (!c.typeArgs.empty() || infer(*c.args[0])->k!=TyKind::Atomic) return nullptr;
+  }
+  if (!c.typeArgs.empty()) fatal(c.callee+" does not take type arguments");
+  if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot use atomics");
+  auto at = infer(*c.args[0]);
+  if (at->k!=TyKind::Atomic) fatal(c.callee+" requires an atomic, got "+at->str());
+  auto& place = *c.args[0];
+  if (!dynamic_cast<EVar*>(&place) && !dynamic_cast<EIndex*>(&place) && !dynamic_cast<EField*>(&place))
+    fatal(c.callee+" requires an atomic variable, element or field");
+  Expr* root = &place;
+  for (;;){
+    if (auto *ix = dynamic_cast<EIndex*>(root)) root = ix->arr.get();
+    else if (auto *f = dynamic_cast<EField*>(root)) root = f->base.get();
+    else break;
+  }
+  if (curEffects && throughRef(*root)){ curEffects->readsMem = true; curEffects->writesMem = true; }
+
+  size_t operands = c.callee=="load" ? 1 : c.callee=="cas" ? 3 : 2;
+  size_t orders = c.callee=="cas" ? 2 : 1;
+  if (c.args.size()<operands || c.args.size()>operands+orders) fatal("wrong number of arguments to "+c.callee);
+  for (size_t k=1; k<operands; ++k){
+    auto vt = infer(*c.args[k]);
+    if (!coerce(*c.args[k], *vt, *at->elem)) fatal(c.callee+" of "+vt->str()+" on "+at->str());
+  }
+  c.imm.clear();
+  for (size_t k=operands; k<c.args.size(); ++k){
+    static const std::unordered_map<std::string, MemOrder> names = {{"relaxed", MemOrder::Relaxed},
+      {"acquire", MemOrder::Acquire}, {"release", MemOrder::Release}, {"acq_rel", MemOrder::AcqRel}, {"seq_cst", MemOrder::SeqCst}};
+    auto *v = dynamic_cast<EVar*>(c.args[k].get());
+    auto it = v ? names.find(v->name) : names.end();
+    if (it==names.end()) fatal(c.callee+" ordering must be relaxed, acquire, release, acq_rel or seq_cst");
+    c.imm.push_back((std::int64_t)it->second);
+  }
+  if (c.imm.empty()) c.imm.push_back((std::int64_t)MemOrder::SeqCst);
+  auto order = (MemOrder)c.imm[0];
+  auto reject = [&](const char* what, MemOrder o){ fatal(std::string(what)+" cannot be "+orderName(o)); };
+  if (c.callee=="load" && (order==MemOrder::Release || order==MemOrder::AcqRel)) reject("a load", order);
+  if (c.callee=="store" && (order==MemOrder::Acquire || order==MemOrder::AcqRel)) reject("a store", order);
+  if (c.callee=="cas"){
+    // the failure ordering is a load: by default the success ordering without its release part
+    if (c.imm.size()==1)
+      c.imm.push_back((std::int64_t)(order==MemOrder::AcqRel ? MemOrder::Acquire : order==MemOrder::Release ? MemOrder::Relaxed : order));
+    auto fail = (MemOrder)c.imm[1];
+    if (fail==MemOrder::Release || fail==MemOrder::AcqRel) reject("the cas failure ordering", fail);
+    return Type::boolean();
+  }
+  return c.callee=="store" ? Type::voidty() : at->elem->clone();
+}
+
+// Iterations of a parallel for run concurrently, so a local shared by them may only be read,
+// indexed into, or updated as one of the loop's reduction variables.
+void Sema::checkShared(Expr& target, const std::string& action){
+  if (parallel.empty()) return;
+  Expr* root = &target;
+  while (auto *f = dynamic_cast<EField*>(root)) root = f->base.get();
+  auto *v = dynamic_cast<EVar*>(root);
+  if (!v || scope.depthOf(v->name)<0 || scope.depthOf(v->name) >= parallel.back().depth) return;
+  for (auto& r : parallel.back().loop->reductions) if (r.var==v->name) return;
+  fatal("cannot "+action+" '"+v->name+"' inside a parallel for: it is shared by all iterations"+
+        (action=="assign to" ? " (use reduce)" : ""));
+}
+
+// Only a direct allocator call or a variable still holding one's result is known; anything
+// else (parameters, loads, calls of user functions, stores Sema has not seen yet) is left to
+// the programmer.
+std::string Sema::allocOrigin(Expr& e){
+  static const char* allocators[] = {"alloc", "alloc_zeroed", "alloc_large", "malloc", "arena_alloc", "pool_alloc", "map_array"};
+  if (auto *c = dynamic_cast<ECall*>(&e)){
+    if (userFns.count(c->callee)) return "";
+    for (auto a : allocators) if (c->callee==a) return a;
+    return "";
+  }
+  if (auto *v = dynamic_cast<EVar*>(&e)){
+    auto vi = scope.lookup(v->name);
+    return vi && !inDefer && vi->originLoop==loopDepth ? vi->origin : "";
+  }
+  return "";
+}
+
+void Sema::noteRefArgs(ECall& c, const FnSig& sig){
+  auto& distinct = refArgsDistinct[c.callee];
+  distinct.resize(sig.params.size(), true);
+  std::vector<const void*> roots;
+  for (size_t k=0; k<c.args.size(); ++k){
+    auto pk = sig.params[k]->k;
+    if (pk==TyKind::Vec) checkShared(*c.args[k], "pass by reference");
+    roots.push_back(pk==TyKind::Array || pk==TyKind::Slice ? refRoot(*c.args[k]) : nullptr);
+  }
+  // a reference of unknown origin (a slice variable, a pointer) might cover any of the others
+  bool unknown = false;
+  for (size_t k=0; k<roots.size(); ++k){
+    auto pk = sig.params[k]->k;
+    if ((pk==TyKind::Array || pk==TyKind::Slice) && !roots[k]) unknown = true;
+  }
+  for (size_t k=0; k<roots.size(); ++k){
+    auto pk = sig.params[k]->k;
+    if (pk!=TyKind::Array && pk!=TyKind::Slice) continue;
+    if (unknown){ distinct[k] = false; continue; }
+    for (size_t j=0; j<roots.size(); ++j) if (j!=k && roots[j]==roots[k]) distinct[k] = false;
+  }
+}
+
+std::unique_ptr<Type> Sema::inferVecOp(ECall& c){
+  static const std::unordered_set<std::string> ops = {"push", "pop", "reserve", "free"};
+  if (!ops.count(c.callee) || c.args.empty()) return nullptr;
+  if (c.callee!="free" && fns.count(c.callee)) return nullptr; // a user function of that name wins
+  auto vt = infer(*c.args[0]);
+  if (vt->k!=TyKind::Vec){
+    if (c.callee=="free") return nullptr;
+    fatal(c.callee+" requires a vec, got "+vt->str());
+  }
+  if (!dynamic_cast<EVar*>(c.args[0].get()) && !dynamic_cast<EIndex*>(c.args[0].get()))
+    fatal(c.callee+" requires a vec variable");
+  if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot modify a vec");
+  checkShared(*c.args[0], c.callee);
+  if (curEffects) curEffects->callees.push_back(c.callee);
+  size_t arity = (c.callee=="push" || c.callee=="reserve") ? 2 : 1;
+  if (c.args.size()!=arity) fatal("wrong number of arguments to "+c.callee);
+  if (c.callee=="push"){
+    auto at = infer(*c.args[1]);
+    rejectVecCopy(*c.args[1], *at);
+    if (!coerce(*c.args[1], *at, *vt->elem)) fatal("push of "+at->str()+" onto "+vt->str());
+  }
+  if (c.callee=="reserve" && !isInt(*infer(*c.args[1]))) fatal("reserve count must be integer");
+  if (c.callee=="pop") return vt->elem->clone();
+  return Type::voidty();
+}
+
+std::unique_ptr<Type> Sema::inferChanOp(ECall& c){
+  static const std::unordered_set<std::string> ops = {"send", "recv", "try_send", "try_recv", "free"};
+  if (!ops.count(c.callee) || c.args.empty()) return nullptr;
+  if (c.callee!="free" && fns.count(c.callee)) return nullptr; // a user function of that name wins
+  auto ct = infer(*c.args[0]);
+  if (ct->k!=TyKind::Chan){
+    if (c.callee=="free") return nullptr;
+    fatal(c.callee+" requires a chan, got "+ct->str());
+  }
+  if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot use channels");
+  if (curEffects) curEffects->callees.push_back("aurora_chan_"+c.callee);
+  size_t arity = (c.callee=="recv" || c.callee=="free") ? 1 : 2;
+  if (c.args.size()!=arity) fatal("wrong number of arguments to "+c.callee);
+  if (c.callee=="send" || c.callee=="try_send"){
+    auto vt = infer(*c.args[1]);
+    rejectVecCopy(*c.args[1], *vt);
+    if (!coerce(*c.args[1], *vt, *ct->elem)) fatal(c.callee+" of "+vt->str()+" on "+ct->str());
+    return c.callee=="send" ? Type::voidty() : Type::boolean();
+  }
+  if (c.callee=="try_recv"){
+    // try_recv(ch, x): on success the element is written to the place x
+    auto& place = *c.args[1];
+    if (!dynamic_cast<EVar*>(&place) && !dynamic_cast<EIndex*>(&place) && !dynamic_cast<EField*>(&place))
+      fatal("try_recv needs a variable, element or field to receive into");
+    if (auto *v = dynamic_cast<EVar*>(&place); v && scope.lookup(v->name) && scope.lookup(v->name)->readOnly)
+      fatal("cannot assign to loop variable '"+v->name+"'");
+    checkShared(place, "assign to");
+    auto pt = infer(place);
+    if (!pt->equals(*ct->elem)) fatal("try_recv into "+pt->str()+" from "+ct->str());
+    if (auto *ix = dynamic_cast<EIndex*>(&place); ix && ix->arr->ty->elem && isSoa(*ix->arr->ty->elem))
+      fatal("try_recv cannot write a whole soa element; receive into a local");
+    return Type::boolean();
+  }
+  return c.callee=="recv" ? ct->elem->clone() : Type::voidty();
+}
+
+// Arena builtins: arena_new([chunk bytes]), arena_alloc<T>(a, n), arena_mark(a),
+// arena_reset(a[, mark]) and arena_free(a); null when c is not one of them.
+std::unique_ptr<Type> Sema::inferArenaOp(ECall& c){
+  static const std::unordered_set<std::string> ops = {"arena_new", "arena_alloc", "arena_mark", "arena_reset", "arena_free"};
+  if (!ops.count(c.callee) || fns.count(c.callee)) return nullptr;
+  if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot allocate");
+  if (c.callee!="arena_alloc" && !c.typeArgs.empty()) fatal(c.callee+" does not take type arguments");
+  if (curEffects) curEffects->callees.push_back("aurora_"+c.callee);
+  if (c.callee=="arena_new"){
+    if (c.args.size()>1) fatal("arena_new expects arena_new() or arena_new(chunk_bytes)");
+    if (!c.args.empty() && !isInt(*infer(*c.args[0]))) fatal("arena chunk size must be integer");
+    return Type::arena();
+  }
+  size_t lo = c.callee=="arena_alloc" ? 2 : 1, hi = c.callee=="arena_mark" || c.callee=="arena_free" ? 1 : 2;
+  if (c.args.size()<lo || c.args.size()>hi) fatal("wrong number of arguments to "+c.callee);
+  auto at = infer(*c.args[0]);
+  if (at->k!=TyKind::Arena) fatal(c.callee+" requires an arena, got "+at->str());
+  if (c.callee=="arena_mark") return Type::i64();
+  // the arena's cursor moves: iterations of a parallel for may not share one
+  checkShared(*c.args[0], c.callee=="arena_alloc" ? "allocate from" : c.callee=="arena_reset" ? "reset" : "free");
+  if (c.callee=="arena_alloc"){
+    if (c.typeArgs.size()!=1) fatal("arena_alloc expects arena_alloc<T>(arena, count)");
+    resolveType(*c.typeArgs[0]);
+    if (isVoid(*c.typeArgs[0])) fatal("cannot allocate void");
+    if (!isInt(*infer(*c.args[1]))) fatal("arena_alloc count must be integer");
+    return Type::ptr(c.typeArgs[0]->clone());
+  }
+  if (c.args.size()==2 && !isInt(*infer(*c.args[1]))) fatal("arena_reset mark must be integer");
+  return Type::voidty();
+}
+
+bool Sema::isPlainData(const Type& t){
+  if (isInt(t)) return true;
+  if (t.k==TyKind::Array || t.k==TyKind::Simd) return isPlainData(*t.elem);
+  if (t.k!=TyKind::Struct || isSoa(t)) return false;
+  for (auto& f : structs.at(t.name)->fields) if (!isPlainData(*f.ty)) return false;
+  return true;
+}
+
+// File builtins; the path is a string literal and the madvise hints are folded into c.imm[0]
+// (1 sequential, 2 random, 4 willneed, 8 hugepage, the runtime's AURORA_MAP_* bits).
+std::unique_ptr<Type> Sema::inferFileOp(ECall& c){
+  static const std::unordered_set<std::string> ops = {"map_array", "unmap", "write_array_bin"};
+  if (!ops.count(c.callee) || fns.count(c.callee)) return nullptr;
+  if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot use files");
+  if (c.callee=="unmap"){
+    if (!c.typeArgs.empty()) fatal("unmap does not take type arguments");
+    if (c.args.size()!=1) fatal("unmap expects the slice returned by map_array");
+    auto st = infer(*c.args[0]);
+    if (st->k!=TyKind::Slice) fatal("unmap requires a slice, got "+st->str());
+    // any other slice may point into the heap or the stack; such variables cannot be
+    // reassigned, so the origin holds in defers and loops too
+    auto *v = dynamic_cast<EVar*>(c.args[0].get());
+    auto vi = v ? scope.lookup(v->name) : nullptr;
+    if (!vi || vi->origin!="map_array") fatal("unmap requires a variable initialized from map_array");
+    if (curEffects) curEffects->callees.push_back("aurora_unmap");
+    return Type::voidty();
+  }
+  if (c.args.empty() || !dynamic_cast<EStr*>(c.args[0].get())) fatal(c.callee+" expects a string literal path first");
+  if (c.callee=="write_array_bin"){
+    if (!c.typeArgs.empty()) fatal("write_array_bin does not take type arguments");
+    if (c.args.size()!=3) fatal("write_array_bin expects write_array_bin(path, src, count)");
+    auto st = infer(*c.args[1]);
+    if (st->k!=TyKind::Array && st->k!=TyKind::Slice && st->k!=TyKind::Vec)
+      fatal("write_array_bin requires an array, slice or vec, got "+st->str());
+    if (!isPlainData(*st->elem)) fatal("write_array_bin cannot write elements of type "+st->elem->str());
+    if (!coerce(*c.args[1], *st, *Type::slice(st->elem->clone()))) fatal("write_array_bin cannot view "+st->str()+" as a slice");
+    if (!isInt(*infer(*c.args[2]))) fatal("write_array_bin count must be integer");
+    if (curEffects) curEffects->callees.push_back("aurora_write_file");
+    return Type::voidty();
+  }
+  if (c.typeArgs.size()!=1) fatal("map_array expects map_array<T>(path, hints...)");
+  resolveType(*c.typeArgs[0]);
+  auto& et = *c.typeArgs[0];
+  if (!isPlainData(et)) fatal("map_array cannot view a file as "+et.str()+" elements");
+  static const std::unordered_map<std::string, std::int64_t> hints = {{"sequential", 1}, {"random", 2}, {"willneed", 4}, {"hugepage", 8}};
+  std::int64_t mask = 0;
+  for (size_t k=1; k<c.args.size(); ++k){
+    auto *v = dynamic_cast<EVar*>(c.args[k].get());
+    auto it = v ? hints.find(v->name) : hints.end();
+    if (it==hints.end()) fatal("map_array hint must be sequential, random, willneed or hugepage");
+    mask |= it->second;
+  }
+  if ((mask & 3)==3) fatal("map_array hints sequential and random exclude each other");
+  c.imm.assign(1, mask);
+  if (curEffects) curEffects->callees.push_back("aurora_map_file");
+  return Type::slice(et.clone());
+}
+
+bool Sema::isSoa(const Type& elem) const {
+  if (elem.k!=TyKind::Struct) return false;
+  auto it = structs.find(elem.name);
+  return it!=structs.end() && it->second->soa;
+}
+
+// Resolves field types and rejects structs that contain themselves by value.
+void Sema::checkStruct(StructDecl& s, std::vector<std::string>& path){
+  for (auto& n : path) if (n==s.name) fatal("struct '"+s.name+"' contains itself");
+  if (s.soa && s.keepOrder) fatal("struct '"+s.name+"' cannot be both soa and keep_order");
+  path.push_back(s.name);
+  std::unordered_set<std::string> seen;
+  for (auto& f : s.fields){
+    if (!seen.insert(f.name).second) fatal("duplicate field '"+f.name+"' in struct "+s.name);
+    resolveType(*f.ty);
+    if (isVoid(*f.ty)) fatal("field '"+f.name+"' cannot have type void");
+    const Type* inner = f.ty.get();
+    while (inner->k==TyKind::Array) inner = inner->elem.get();
+    if (inner->k==TyKind::Struct) checkStruct(*structs[inner->name], path);
+  }
+  path.pop_back();
+}
+
+void Sema::resolveType(Type& t){
+  if (t.elem) resolveType(*t.elem);
+  if (t.k==TyKind::Struct && !structs.count(t.name)) fatal("unknown type '"+t.name+"'");
+  if ((t.k==TyKind::Array || t.k==TyKind::Simd) && t.sizeExpr){
+    auto v = ceval.eval(*t.sizeExpr);
+    if (v.isArray || v.isBool) fatal("array size must be an integer constant");
+    if (v.v<=0) fatal("array size must be positive, got "+std::to_string(v.v));
+    t.arraySize = v.v;
+    t.sizeExpr.reset();
+  }
+  if (t.k==TyKind::Atomic && !isInt(*t.elem)) fatal("atomic<T> needs i32 or i64, got "+t.elem->str());
+  if (t.k==TyKind::Simd){
+    if (!isInt(*t.elem) && t.elem->k!=TyKind::Bool) fatal("simd lanes must be i32, i64 or bool, got "+t.elem->str());
+    if (t.arraySize<1 || t.arraySize>64 || (t.arraySize & (t.arraySize-1)))
+      fatal("simd lane count must be a power of two up to 64, got "+std::to_string(t.arraySize));
+  }
+}
+
+// Element-wise operators: both sides simd<T,N>, or one side a scalar T that is splatted.
+std::unique_ptr<Type> Sema::inferSimdBin(EBin& bin, std::unique_ptr<Type> lt, std::unique_ptr<Type> rt){
+  bool leftVec = lt->k==TyKind::Simd;
+  auto& vt = leftVec ? *lt : *rt;
+  auto& st = leftVec ? *rt : *lt;
+  auto& scalar = leftVec ? *bin.rhs : *bin.lhs;
+  if (st.k==TyKind::Simd){ if (!st.equals(vt)) fatal("simd operand mismatch: "+lt->str()+" vs "+rt->str()); }
+  else if (!coerce(scalar, st, *vt.elem)) fatal("cannot combine "+vt.str()+" with "+st.str());
+  bool mask = vt.elem->k==TyKind::Bool;
+  switch (bin.op){
+    case TokKind::Plus: case TokKind::Minus: case TokKind::Star: case TokKind::Slash: case TokKind::Percent:
+      if (mask) fatal("arithmetic on simd<bool> masks");
+      return vt.clone();
+    case TokKind::EqEq: case TokKind::BangEq: case TokKind::Lt: case TokKind::Le: case TokKind::Gt: case TokKind::Ge:
+      return Type::simd(Type::boolean(), vt.arraySize);
+    case TokKind::AmpAmp: case TokKind::PipePipe:
+      if (!mask) fatal("&& and || need simd<bool> masks");
+      return vt.clone();
+    default: fatal("unsupported simd operator");
+  }
+}
+
+// Data-parallel builtins; null when c is not one of them (or a user function shadows it).
+std::unique_ptr<Type> Sema::inferSimdOp(ECall& c){
+  static const std::unordered_set<std::string> ops = {"simd", "splat", "load", "store", "shuffle", "select",
+    "reduce_add", "reduce_mul", "reduce_min", "reduce_max", "any", "all"};
+  if (!ops.count(c.callee) || fns.count(c.callee)) return nullptr;
+  if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot use simd");
+  auto argc = [&](size_t n){ if (c.args.size()!=n) fatal("wrong number of arguments to "+c.callee); };
+  auto simdArg = [&](size_t k){
+    auto t = infer(*c.args[k]);
+    if (t->k!=TyKind::Simd) fatal(c.callee+" expects a simd value, got "+t->str());
+    return t;
+  };
+  // element storage a simd load/store can address: slices, arrays, vecs, typed pointers
+  auto memArg = [&](size_t k, const Type& elem){
+    auto t = infer(*c.args[k]);
+    bool ok = (t->k==TyKind::Slice || t->k==TyKind::Array || t->k==TyKind::Vec || t->k==TyKind::Ptr) && t->elem && !isSoa(*t->elem);
+    if (!ok || !t->elem->equals(elem)) fatal(c.callee+" needs a slice of "+elem.str()+", got "+t->str());
+    if (!isInt(*infer(*c.args[k+1]))) fatal(c.callee+" index must be integer");
+  };
+  if (c.callee=="simd" || c.callee=="splat" || c.callee=="load"){
+    if (c.typeArgs.size()!=1 || c.typeArgs[0]->k!=TyKind::Simd) fatal(c.callee+" expects "+c.callee+"<T, N>(...)");
+    resolveType(*c.typeArgs[0]);
+    auto& vt = *c.typeArgs[0];
+    if (c.callee=="load"){
+      argc(2);
+      memArg(0, *vt.elem);
+      if (curEffects && throughRef(*c.args[0])) curEffects->readsMem = true;
+      return vt.clone();
+    }
+    // splat<T,N>(x) / simd<T,N>(x) broadcast; simd<T,N>(x0, ..., xN-1) builds lane by lane
+    if (c.args.size()!=1 && (c.callee=="splat" || (int64_t)c.args.size()!=vt.arraySize))
+      fatal(c.callee+" takes 1 or "+std::to_string(vt.arraySize)+" lane values");
+    for (auto& a : c.args){
+      auto t = infer(*a);
+      if (!coerce(*a, *t, *vt.elem)) fatal("lane value "+t->str()+" does not fit "+vt.str());
+    }
+    return vt.clone();
+  }
+  if (!c.typeArgs.empty()) fatal(c.callee+" does not take type arguments");
+  if (c.callee=="store"){
+    // store(dst, i, v): writes the lanes of v to dst[i..i+N)
+    argc(3);
+    auto vt = simdArg(2);
+    memArg(0, *vt->elem);
+    if (curEffects && throughRef(*c.args[0])) curEffects->writesMem = true;
+    return Type::voidty();
+  }
+  if (c.callee=="shuffle"){
+    // shuffle(a, [lanes]) or shuffle(a, b, [lanes]); lane k >= N picks from b
+    if (c.args.size()!=2 && c.args.size()!=3) fatal("shuffle expects shuffle(a, [lanes]) or shuffle(a, b, [lanes])");
+    auto vt = simdArg(0);
+    if (c.args.size()==3 && !simdArg(1)->equals(*vt)) fatal("shuffle operands must have the same type");
+    auto& m = *c.args.back();
+    infer(m);
+    auto lanes = ceval.eval(m);
+    if (!lanes.isArray) fatal("shuffle lanes must be a constant array");
+    int64_t limit = vt->arraySize * (int64_t)(c.args.size()-1);
+    c.imm.clear();
+    for (auto& l : lanes.elems){
+      if (l.v<0 || l.v>=limit) fatal("shuffle lane "+std::to_string(l.v)+" out of range");
+      c.imm.push_back(l.v);
+    }
+    auto r = Type::simd(vt->elem->clone(), (int64_t)c.imm.size());
+    resolveType(*r);
+    return r;
+  }
+  if (c.callee=="select"){
+    // select(mask, a, b): lane-wise mask ? a : b
+    argc(3);
+    auto mt = simdArg(0);
+    auto at = simdArg(1), bt = simdArg(2);
+    if (mt->elem->k!=TyKind::Bool || mt->arraySize!=at->arraySize || !at->equals(*bt))
+      fatal("select expects simd<bool,N> and two matching simd<T,N> values");
+    return at;
+  }
+  argc(1);
+  auto vt = simdArg(0);
+  bool mask = vt->elem->k==TyKind::Bool;
+  if ((c.callee=="any" || c.callee=="all") != mask)
+    fatal(c.callee+(mask ? " does not apply to masks" : " expects a simd<bool,N> mask"));
+  return mask ? Type::boolean() : vt->elem->clone();
+}
+
+const ConstValue* Sema::constValue(const std::string& name){
+  auto it = consts.find(name);
+  if (it==consts.end()) return nullptr;
+  auto& c = *it->second;
+  auto& st = constState[name];
+  if (st==2) return &c.value;
+  if (st==1) fatal("constant '"+name+"' depends on itself");
+  st = 1;
+  auto v = ceval.eval(*c.init);
+  if (c.ty){ resolveType(*c.ty); ceval.coerce(v, *c.ty); }
+  c.value = std::move(v);
+  st = 2;
+  return &c.value;
+}
+
+const Type& Sema::constType(ConstDecl& c){
+  if (!c.ty){
+    auto t = infer(*c.init);
+    if (t->k!=TyKind::I64 && t->k!=TyKind::I32 && t->k!=TyKind::Bool && t->k!=TyKind::Array)
+      fatal("constant '"+c.name+"' cannot have type "+t->str());
+    c.ty = std::move(t);
+  }
+  return *c.ty;
+}
+
 void Sema::primaries(){
   // Builtins: i64 print/read, malloc/free
   {
@@ -19,50 +559,140 @@ void Sema::primaries(){
     FnSig s; s.ret = Type::i64();
     fns["read_i64"] = std::move(s);
   }
+  {
+    // read_array_i64(dst, n) / print_array_i64(src, n, sep): n elements of a slice at once; sep is a byte
+    FnSig r; r.params.push_back(Type::slice(Type::i64())); r.params.push_back(Type::i64()); r.ret = Type::voidty();
+    fns["read_array_i64"] = std::move(r);
+    FnSig w; w.params.push_back(Type::slice(Type::i64())); w.params.push_back(Type::i64()); w.params.push_back(Type::i64());
+    w.ret = Type::voidty();
+    fns["print_array_i64"] = std::move(w);
+  }
   {
     FnSig s; s.params.push_back(Type::i64());
     s.ret = Type::ptr(Type::i64()); // treat as ptr<i64> for MVP
     fns["malloc"] = std::move(s);
   }
   {
-    // free now returns void
-    FnSig s; s.params.push_back(Type::ptr(Type::i64()));
+    // free now returns void; accepts any ptr<T>
+    FnSig s; s.params.push_back(Type::ptr(nullptr));
     s.ret = Type::voidty();
     fns["free"] = std::move(s);
   }
 }
 
+bool Sema::coerce(Expr& e, const Type& from, const Type& to){
+  if (from.equals(to)) return true;
+  if (to.k==TyKind::Ptr && !to.elem && from.k==TyKind::Ptr) return true; // ptr<?> accepts any pointer
+  if ((from.k==TyKind::Array || from.k==TyKind::Vec) && to.k==TyKind::Slice && isSoa(*from.elem))
+    return false; // column-wise storage has no contiguous rows to view
+  if (from.k==TyKind::Array && to.k==TyKind::Slice){
+    // T[N] -> []T refers to the array in place; CodeGen builds {data, N}
+    if (from.elem->equals(*to.elem)) return true;
+    auto arr = Type::array(to.elem->clone(), from.arraySize);
+    return coerce(e, from, *arr);
+  }
+  if (from.k==TyKind::Vec && to.k==TyKind::Slice) return from.elem->equals(*to.elem); // current contents
+  if (isInt(from) && isInt(to)){
+    bool constant = isIntLiteral(e);
+    if (auto *v = dynamic_cast<EVar*>(&e)) constant = !scope.lookup(v->name) && consts.count(v->name);
+    if (constant){ retype(e, to); return true; }
+  }
+  if (from.k==TyKind::Array && to.k==TyKind::Array && from.arraySize==to.arraySize){
+    bool ok = true;
+    if (auto *a = dynamic_cast<EArrayLit*>(&e))
+      for (auto& el : a->elems) ok = ok && coerce(*el, *from.elem, *to.elem);
+    else if (auto *r = dynamic_cast<EArrayRepeat*>(&e))
+      ok = coerce(*r->value, *from.elem, *to.elem);
+    else ok = false;
+    if (ok) e.ty = to.clone();
+    return ok;
+  }
+  return false;
+}
+
 std::unique_ptr<Type> Sema::infer(Expr& e){
-  if (auto *x = dynamic_cast<EInt*>(&e))  { (void)x; return Type::i64(); }
+  auto t = inferExpr(e);
+  e.ty = t->clone();
+  return t;
+}
+
+std::unique_ptr<Type> Sema::inferExpr(Expr& e){
+  if (auto *x = dynamic_cast<EInt*>(&e))  { return x->ty ? x->ty->clone() : Type::i64(); } // keeps a coerced width
   if (auto *b = dynamic_cast<EBool*>(&e)) { (void)b; return Type::boolean(); }
+  if (dynamic_cast<EStr*>(&e)) fatal("string literals are only allowed as file paths");
 
   if (auto *v = dynamic_cast<EVar*>(&e)){
+    bool based = indexBaseOk; indexBaseOk = false;
     auto vi = scope.lookup(v->name);
-    if (!vi) fatal("unknown variable: "+v->name);
+    if (!vi){
+      auto ci = consts.find(v->name);
+      if (ci!=consts.end()){
+        auto& ct = constType(*ci->second);
+        return (v->ty && isInt(ct) && isInt(*v->ty)) ? v->ty->clone() : ct.clone(); // keeps a coerced width
+      }
+      fatal("unknown variable: "+v->name);
+    }
+    noteCapture(v->name);
+    if (vi->let && !based) vi->let->onStack = false;
     return vi->ty->clone();
   }
 
   if (auto *u = dynamic_cast<EUnary*>(&e)){
     auto t = infer(*u->rhs);
-    requireNonVoid(*t, "unary operator");
+    requireValue(*t, "unary operator");
     return t->clone();
   }
 
   if (auto *bin = dynamic_cast<EBin*>(&e)){
     if (bin->op==TokKind::Eq){
+      Expr* root = bin->lhs.get();
+      for (;;){
+        if (auto *ix = dynamic_cast<EIndex*>(root)) root = ix->arr.get();
+        else if (auto *f = dynamic_cast<EField*>(root)) root = f->base.get();
+        else break;
+      }
+      if (auto *rv = dynamic_cast<EVar*>(root)){
+        auto vi = scope.lookup(rv->name);
+        if (!vi && consts.count(rv->name)) fatal("cannot assign to constant '"+rv->name+"'");
+        if (vi && vi->readOnly) fatal("cannot assign to loop variable '"+rv->name+"'");
+      }
+      checkShared(*bin->lhs, "assign to");
       auto tL = infer(*bin->lhs);
+      if (tL->k==TyKind::Atomic) fatal("cannot assign to an atomic; use store(a, v)");
       auto tR = infer(*bin->rhs);
+      Expr* place = nullptr;
+      if (auto *ix = dynamic_cast<EIndex*>(bin->lhs.get())) place = ix->arr.get();
+      else if (auto *f = dynamic_cast<EField*>(bin->lhs.get())) place = f->base.get();
+      else if (!dynamic_cast<EVar*>(bin->lhs.get())) fatal("invalid assignment target");
+      if (place && throughRef(*place)){
+        if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot write through array parameter");
+        if (curEffects) curEffects->writesMem = true;
+      }
       if (isVoid(*tR)) fatal("cannot assign a void value");
-      if (!tL->equals(*tR)) fatal("type mismatch in assignment: "+tL->str()+" vs "+tR->str());
+      rejectVecCopy(*bin->rhs, *tR);
+      if (!coerce(*bin->rhs, *tR, *tL)) fatal("type mismatch in assignment: "+tL->str()+" vs "+tR->str());
+      // a store in a nested block may not run, so afterwards the origin is unknown
+      if (auto *lv = dynamic_cast<EVar*>(bin->lhs.get()))
+        if (auto vi = scope.lookup(lv->name)){
+          if (vi->origin=="map_array") fatal("cannot assign to '"+lv->name+"': it holds a mapping from map_array");
+          vi->origin = scope.depthOf(lv->name)==(int)scope.stack.size()-1 ? allocOrigin(*bin->rhs) : "";
+          vi->originLoop = loopDepth;
+        }
       return tL;
     }
 
-    // arithmetic => i64 (operands must be non-void)
+    // arithmetic => the operands' integer type; a literal operand adopts the other side's width,
+    // mixed i32/i64 widens to i64 (operands must be non-void)
     if (bin->op==TokKind::Plus || bin->op==TokKind::Minus || bin->op==TokKind::Star ||
         bin->op==TokKind::Slash || bin->op==TokKind::Percent){
       auto lt = infer(*bin->lhs), rt = infer(*bin->rhs);
-      requireNonVoid(*lt, "arithmetic operator");
-      requireNonVoid(*rt, "arithmetic operator");
+      requireValue(*lt, "arithmetic operator");
+      requireValue(*rt, "arithmetic operator");
+      if (lt->k==TyKind::Simd || rt->k==TyKind::Simd) return inferSimdBin(*bin, std::move(lt), std::move(rt));
+      if (isInt(*lt) && isInt(*rt)){
+        if (coerce(*bin->rhs, *rt, *lt)) return lt;
+        if (coerce(*bin->lhs, *lt, *rt)) return rt;
+      }
       return Type::i64();
     }
 
@@ -70,55 +700,225 @@ std::unique_ptr<Type> Sema::infer(Expr& e){
     if (bin->op==TokKind::EqEq || bin->op==TokKind::BangEq || bin->op==TokKind::Lt ||
         bin->op==TokKind::Le   || bin->op==TokKind::Gt    || bin->op==TokKind::Ge){
       auto lt = infer(*bin->lhs), rt = infer(*bin->rhs);
-      requireNonVoid(*lt, "comparison");
-      requireNonVoid(*rt, "comparison");
+      requireValue(*lt, "comparison");
+      requireValue(*rt, "comparison");
+      if (lt->k==TyKind::Struct || rt->k==TyKind::Struct) fatal("cannot compare struct values");
+      if (lt->k==TyKind::Simd || rt->k==TyKind::Simd) return inferSimdBin(*bin, std::move(lt), std::move(rt));
+      if (isInt(*lt) && isInt(*rt) && !coerce(*bin->rhs, *rt, *lt)) coerce(*bin->lhs, *lt, *rt);
       return Type::boolean();
     }
 
     // logical -> bool
     if (bin->op==TokKind::AmpAmp || bin->op==TokKind::PipePipe){
       auto lt = infer(*bin->lhs), rt = infer(*bin->rhs);
-      requireNonVoid(*lt, "logical operator");
-      requireNonVoid(*rt, "logical operator");
+      requireValue(*lt, "logical operator");
+      requireValue(*rt, "logical operator");
+      if (lt->k==TyKind::Simd || rt->k==TyKind::Simd) return inferSimdBin(*bin, std::move(lt), std::move(rt));
       return Type::boolean();
     }
   }
 
   if (auto *c = dynamic_cast<ECall*>(&e)){
+    bool genOk = genCallOk; genCallOk = false;
+    if (c->callee=="alloc"){
+      // alloc<T>(n) -> ptr<T>: malloc of n * sizeof(T)
+      if (c->typeArgs.size()!=1 || c->args.size()!=1) fatal("alloc expects alloc<T>(count)");
+      resolveType(*c->typeArgs[0]);
+      if (isVoid(*c->typeArgs[0])) fatal("cannot allocate void");
+      auto nt = infer(*c->args[0]);
+      if (!isInt(*nt)) fatal("alloc count must be integer");
+      if (curEffects) curEffects->callees.push_back(c->callee);
+      if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot allocate");
+      return Type::ptr(c->typeArgs[0]->clone());
+    }
+    if ((c->callee=="alloc_zeroed" || c->callee=="alloc_large") && !fns.count(c->callee)){
+      // alloc_zeroed<T>(n): calloc; alloc_large<T>(n[, hugepages]): an anonymous mapping, 64-byte
+      // aligned and on huge pages unless hugepages is false. Both read as zero until written.
+      bool large = c->callee=="alloc_large";
+      if (c->typeArgs.size()!=1 || c->args.empty() || c->args.size()>(large ? 2u : 1u))
+        fatal(large ? "alloc_large expects alloc_large<T>(count[, hugepages])" : "alloc_zeroed expects alloc_zeroed<T>(count)");
+      resolveType(*c->typeArgs[0]);
+      if (isVoid(*c->typeArgs[0])) fatal("cannot allocate void");
+      if (!isInt(*infer(*c->args[0]))) fatal(c->callee+" count must be integer");
+      if (large && c->args.size()==2 && infer(*c->args[1])->k!=TyKind::Bool) fatal("alloc_large hugepages must be a bool");
+      if (curEffects) curEffects->callees.push_back(large ? "aurora_alloc_large" : "calloc");
+      if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot allocate");
+      return Type::ptr(c->typeArgs[0]->clone());
+    }
+    if (c->callee=="free_large" && !fns.count(c->callee)){
+      if (!c->typeArgs.empty() || c->args.size()!=1) fatal("free_large expects free_large(ptr)");
+      if (infer(*c->args[0])->k!=TyKind::Ptr) fatal("free_large requires a pointer from alloc_large");
+      if (curEffects) curEffects->callees.push_back("aurora_free_large");
+      return Type::voidty();
+    }
+    if (c->callee=="vec"){
+      // vec<T>() / vec<T>(capacity) -> empty growable vector
+      if (c->typeArgs.size()!=1 || c->args.size()>1) fatal("vec expects vec<T>() or vec<T>(capacity)");
+      resolveType(*c->typeArgs[0]);
+      if (isVoid(*c->typeArgs[0])) fatal("vec element type cannot be void");
+      if (!c->args.empty() && !isInt(*infer(*c->args[0]))) fatal("vec capacity must be integer");
+      if (curEffects) curEffects->callees.push_back(c->callee);
+      if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot allocate");
+      return Type::vec(c->typeArgs[0]->clone());
+    }
+    if ((c->callee=="chan" || c->callee=="spsc_chan") && !fns.count(c->callee)){
+      // chan<T>(capacity) -> bounded MPMC channel; spsc_chan<T> when one task sends and one receives
+      if (c->typeArgs.size()!=1 || c->args.size()!=1) fatal(c->callee+" expects "+c->callee+"<T>(capacity)");
+      resolveType(*c->typeArgs[0]);
+      auto& et = *c->typeArgs[0];
+      if (isVoid(et) || et.k==TyKind::Vec || et.k==TyKind::Future || hasAtomic(et))
+        fatal("channel elements cannot be "+et.str());
+      if (!isInt(*infer(*c->args[0]))) fatal(c->callee+" capacity must be integer");
+      if (curEffects) curEffects->callees.push_back("aurora_chan_new");
+      if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot allocate");
+      return Type::chan(et.clone());
+    }
+    if ((c->callee=="pool_alloc" || c->callee=="pool_free") && !fns.count(c->callee)){
+      // pool_alloc<T>() -> ptr<T> from T's size class; pool_free(p) puts p back on this thread's list
+      if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot allocate");
+      if (curEffects) curEffects->callees.push_back("aurora_"+c->callee);
+      if (c->callee=="pool_alloc"){
+        if (c->typeArgs.size()!=1 || !c->args.empty()) fatal("pool_alloc expects pool_alloc<T>()");
+        resolveType(*c->typeArgs[0]);
+        if (isVoid(*c->typeArgs[0])) fatal("cannot allocate void");
+        return Type::ptr(c->typeArgs[0]->clone());
+      }
+      if (!c->typeArgs.empty() || c->args.size()!=1) fatal("pool_free expects pool_free(ptr)");
+      auto pt = infer(*c->args[0]);
+      if (pt->k!=TyKind::Ptr || !pt->elem) fatal("pool_free requires a typed pointer, got "+pt->str());
+      auto origin = allocOrigin(*c->args[0]);
+      if (!origin.empty() && origin!="pool_alloc") fatal("pool_free of a pointer from "+origin+"; only pool_alloc memory goes back to a pool");
+      return Type::voidty();
+    }
+    if (auto t = inferAtomicOp(*c)) return t;
+    if (auto t = inferSimdOp(*c)) return t;
+    if (auto t = inferArenaOp(*c)) return t;
+    if (auto t = inferFileOp(*c)) return t;
+    if (!c->typeArgs.empty()) fatal(c->callee+" does not take type arguments");
+    if (auto t = inferVecOp(*c)) return t;
+    if (auto t = inferChanOp(*c)) return t;
+    if (c->callee=="len" && !fns.count("len")){
+      if (c->args.size()!=1) fatal("len expects one argument");
+      auto t = infer(*c->args[0]);
+      if (t->k!=TyKind::Array && t->k!=TyKind::Slice && t->k!=TyKind::Vec) fatal("len requires an array, slice or vec, got "+t->str());
+      if (t->k==TyKind::Vec && curEffects) curEffects->readsMem = true;
+      return Type::i64();
+    }
+    if (c->callee=="join" && !fns.count("join")){
+      // join(f) waits for a spawned call and yields its result
+      if (c->args.size()!=1) fatal("join expects one future");
+      auto t = infer(*c->args[0]);
+      if (t->k!=TyKind::Future) fatal("join requires a future, got "+t->str());
+      if (curEffects) curEffects->callees.push_back("aurora_join");
+      return t->elem->clone();
+    }
+    if (c->callee=="slice" && !fns.count("slice")){
+      // slice(p, n) -> []T viewing n elements at p
+      if (c->args.size()!=2) fatal("slice expects slice(ptr, count)");
+      auto pt = infer(*c->args[0]);
+      if (pt->k!=TyKind::Ptr || !pt->elem) fatal("slice requires a typed pointer, got "+pt->str());
+      auto nt = infer(*c->args[1]);
+      if (!isInt(*nt)) fatal("slice count must be integer");
+      if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot create slices");
+      return Type::slice(pt->elem->clone());
+    }
     auto it = fns.find(c->callee);
     if (it==fns.end()) fatal("unknown function: "+c->callee);
 
     // Arity + argument type checks
     auto &sig = it->second;
+    if (!genOk && userFns.count(c->callee) && userFns[c->callee]->isGen)
+      fatal("generator '"+c->callee+"' can only be called as the source of a for loop");
+    if (curEffects) curEffects->callees.push_back(c->callee);
+    if (currentFn && currentFn->isConst && !sig.isConst)
+      fatal("const fn '"+currentFn->name+"' cannot call non-const function '"+c->callee+"'");
     if (c->args.size() != sig.params.size())
       fatal("wrong number of arguments to "+c->callee);
 
     for (size_t k=0; k<c->args.size(); ++k){
       auto at = infer(*c->args[k]);
       if (isVoid(*at)) fatal("argument "+std::to_string(k+1)+" to "+c->callee+" is void");
-      if (!at->equals(*sig.params[k]))
+      if (sig.params[k]->k==TyKind::Struct) rejectVecCopy(*c->args[k], *at); // passed by value
+      if (!coerce(*c->args[k], *at, *sig.params[k]))
         fatal("argument "+std::to_string(k+1)+" type mismatch in "+c->callee);
     }
+    noteRefArgs(*c, sig);
     return sig.ret->clone(); // may be void
   }
 
+  if (auto *sp = dynamic_cast<ESpawn*>(&e)){
+    auto& c = static_cast<ECall&>(*sp->call);
+    if (!userFns.count(c.callee)) fatal("spawn requires a user function, got '"+c.callee+"'");
+    if (currentFn && currentFn->isConst) fatal("const fn '"+currentFn->name+"' cannot spawn");
+    if (!parallel.empty()) fatal("spawn is not allowed in a parallel for");
+    if (currentFn && currentFn->isGen) fatal("gen fn '"+currentFn->name+"' cannot spawn");
+    auto t = infer(c);
+    sawSpawn = true;
+    if (curEffects) curEffects->callees.push_back("aurora_spawn");
+    return Type::future(std::move(t));
+  }
+
   if (auto *a = dynamic_cast<EArrayLit*>(&e)){
     if (a->elems.empty()) fatal("cannot infer type of empty array literal");
     auto elemType = infer(*a->elems[0]);
+    rejectVecCopy(*a->elems[0], *elemType);
     // Check all elements have same type
     for (size_t i = 1; i < a->elems.size(); ++i){
       auto t = infer(*a->elems[i]);
       if (!t->equals(*elemType)) fatal("array literal has mixed types");
+      rejectVecCopy(*a->elems[i], *t);
     }
     return Type::array(std::move(elemType), a->elems.size());
   }
 
+  if (auto *rep = dynamic_cast<EArrayRepeat*>(&e)){
+    auto elemType = infer(*rep->value);
+    requireNonVoid(*elemType, "array repeat literal");
+    rejectVecCopy(*rep->value, *elemType);
+    { auto ct = infer(*rep->count); if (ct->k!=TyKind::I64 && ct->k!=TyKind::I32) fatal("array repeat count must be integer"); }
+    auto n = ceval.eval(*rep->count).v;
+    if (n<=0) fatal("array repeat count must be positive");
+    rep->n = n;
+    return Type::array(std::move(elemType), n);
+  }
+
+  if (auto *f = dynamic_cast<EField*>(&e)){
+    auto bt = infer(*f->base);
+    if (bt->k!=TyKind::Struct) fatal("field access ."+f->name+" on non-struct type "+bt->str());
+    auto& sd = *structs[bt->name];
+    for (size_t k=0; k<sd.fields.size(); ++k)
+      if (sd.fields[k].name==f->name){ f->index = (int)k; return sd.fields[k].ty->clone(); }
+    fatal("struct "+sd.name+" has no field '"+f->name+"'");
+  }
+
+  if (auto *lit = dynamic_cast<EStruct*>(&e)){
+    auto it = structs.find(lit->name);
+    if (it==structs.end()) fatal("unknown struct '"+lit->name+"'");
+    auto& sd = *it->second;
+    std::unordered_set<std::string> given;
+    for (auto& [name, init] : lit->inits){
+      const Param* field = nullptr;
+      for (auto& fd : sd.fields) if (fd.name==name) field = &fd;
+      if (!field) fatal("struct "+sd.name+" has no field '"+name+"'");
+      if (!given.insert(name).second) fatal("field '"+name+"' initialized twice");
+      auto t = infer(*init);
+      rejectVecCopy(*init, *t);
+      if (!coerce(*init, *t, *field->ty))
+        fatal("type mismatch for field "+sd.name+"."+name+": "+field->ty->str()+" vs "+t->str());
+    }
+    return Type::structTy(sd.name); // omitted fields are zero
+  }
+
   if (auto *idx = dynamic_cast<EIndex*>(&e)){
+    indexBaseOk = dynamic_cast<EVar*>(idx->arr.get())!=nullptr;
     auto arrType = infer(*idx->arr);
-    // Allow indexing on both arrays and pointers
-    if (arrType->k != TyKind::Array && arrType->k != TyKind::Ptr) {
-      fatal("indexing requires array or pointer type, got: "+arrType->str());
+    // Allow indexing on arrays, slices, vecs, pointers and simd lanes
+    if (arrType->k != TyKind::Array && arrType->k != TyKind::Ptr && arrType->k != TyKind::Slice &&
+        arrType->k != TyKind::Vec && arrType->k != TyKind::Simd) {
+      fatal("indexing requires array, slice, vec, simd or pointer type, got: "+arrType->str());
     }
+    if (arrType->k == TyKind::Ptr && !arrType->elem) fatal("cannot index "+arrType->str());
+    if (curEffects && throughRef(*idx->arr)) curEffects->readsMem = true;
     auto idxType = infer(*idx->idx);
     // (void is rejected implicitly here; require i64/i32 as you had)
     if (idxType->k != TyKind::I64 && idxType->k != TyKind::I32) fatal("array index must be integer");
@@ -128,18 +928,49 @@ std::unique_ptr<Type> Sema::infer(Expr& e){
   fatal("cannot infer expression");
 }
 
-void Sema::checkStmt(Stmt& s, const Type* currentRet, std::vector<Expr*>& defers){
+void Sema::checkStmt(Stmt& s, const Type* currentRet){
   if (auto *sl = dynamic_cast<SLet*>(&s)){
-    auto t = sl->annType ? sl->annType->clone() : infer(*sl->init);
+    if (sl->annType) resolveType(*sl->annType);
+    if (sl->isUnique && currentFn && currentFn->isConst) fatal("unique<T> is not allowed in const fn");
+    if (sl->isUnique && currentFn && currentFn->isGen) fatal("unique<T> is not allowed in gen fn"); // destroy skips cleanups
+    auto initType = infer(*sl->init);
+    rejectVecCopy(*sl->init, *initType);
+    if (sl->annType && !isVoid(*initType) && !coerce(*sl->init, *initType, *sl->annType))
+      fatal("type mismatch in initializer of '"+sl->name+"': "+sl->annType->str()+" vs "+initType->str());
+    auto t = sl->annType ? sl->annType->clone() : initType->clone();
+    if (!sl->annType) sl->annType = initType->clone(); // CodeGen reads the resolved type
     if (t->k == TyKind::Void)
       fatal("variable '"+sl->name+"' cannot have type void");
     if (!scope.declare(sl->name, std::move(t), sl->isUnique))
       fatal("redeclaration: "+sl->name);
+    auto& declared = scope.stack.back().at(sl->name);
+    declared.origin = allocOrigin(*sl->init);
+    declared.originLoop = loopDepth;
     if (sl->isUnique) {
-      // implicit RAII: defer free(name);
-      auto call = new ECall("free");
+      // implicit RAII: defer free(name); an arena is freed whole, a mark rewinds its arena,
+      // pool memory goes back to its pool, a large mapping is unmapped, and memory an arena owns needs nothing
+      auto *init = dynamic_cast<ECall*>(sl->init.get());
+      auto builtin = [&](const char* name){ return init && init->callee==name && !userFns.count(name); };
+      if (builtin("arena_alloc")) return;
+      auto call = std::make_unique<ECall>(sl->annType->k==TyKind::Arena ? "arena_free" : builtin("arena_mark") ? "arena_reset" :
+                                          builtin("pool_alloc") ? "pool_free" : builtin("alloc_large") ? "free_large" : "free");
+      if (call->callee=="arena_reset"){
+        auto *a = dynamic_cast<EVar*>(init->args[0].get());
+        if (!a) fatal("unique arena mark '"+sl->name+"' needs an arena variable");
+        call->args.push_back(std::make_unique<EVar>(a->name));
+      }
       call->args.push_back(std::make_unique<EVar>(sl->name));
-      defers.push_back(call);
+      if (call->callee=="free" && sl->annType->k!=TyKind::Ptr && sl->annType->k!=TyKind::Vec && sl->annType->k!=TyKind::Chan)
+        fatal("unique '"+sl->name+"' must hold a pointer, vec, chan or arena, got "+sl->annType->str());
+      (void)infer(*call);
+      sl->cleanup = std::move(call);
+      // alloc<T>(constant) whose pointer is only ever indexed may live on the stack instead;
+      // any other use of the name (copy, call argument, return, assignment) clears onStack
+      if (builtin("alloc")){
+        auto *n = dynamic_cast<EVar*>(init->args[0].get());
+        sl->onStack = dynamic_cast<EInt*>(init->args[0].get()) || (n && !scope.lookup(n->name) && consts.count(n->name));
+        if (sl->onStack) scope.stack.back().at(sl->name).let = sl;
+      }
     }
     return;
   }
@@ -151,38 +982,98 @@ void Sema::checkStmt(Stmt& s, const Type* currentRet, std::vector<Expr*>& defers
 
   if (auto *sr = dynamic_cast<SReturn*>(&s)){
     if (!currentRet) fatal("return outside function");
+    if (!parallel.empty()) fatal("return is not allowed in a parallel for");
+    if (currentFn && currentFn->isGen){
+      if (sr->e) fatal("return in gen fn '"+currentFn->name+"' cannot carry a value; use yield");
+      return;
+    }
     if (currentRet->k == TyKind::Void){
       if (sr->e) fatal("void function cannot return a value");
     } else {
       if (!sr->e) fatal("non-void function must return a value");
       auto t = infer(*sr->e);
-      if (!t->equals(*currentRet))
+      if (currentRet->k==TyKind::Slice && t->k==TyKind::Array && refRoot(*sr->e) && !throughRef(*sr->e))
+        fatal("cannot return a slice of a local array");
+      if (!coerce(*sr->e, *t, *currentRet))
         fatal("return type mismatch, expected "+currentRet->str()+" got "+t->str());
     }
     return;
   }
 
   if (auto *si = dynamic_cast<SIf*>(&s)){
-    { auto t = infer(*si->cond); requireNonVoid(*t, "if condition"); }
+    { auto t = infer(*si->cond); requireValue(*t, "if condition"); }
     scope.push(); {
-      std::vector<Expr*> localDefers;
-      for(auto& st: si->thenStmts) checkStmt(*st, currentRet, localDefers); /* defers run at scope exit */
+      for(auto& st: si->thenStmts) checkStmt(*st, currentRet);
     }
     scope.pop();
     scope.push(); {
-      std::vector<Expr*> localDefers;
-      for(auto& st: si->elseStmts) checkStmt(*st, currentRet, localDefers);
+      for(auto& st: si->elseStmts) checkStmt(*st, currentRet);
     }
     scope.pop();
     return;
   }
 
+  if (auto *sf = dynamic_cast<SFor*>(&s); sf && sf->gen){
+    auto *c = dynamic_cast<ECall*>(sf->gen.get());
+    if (!c || !userFns.count(c->callee) || !userFns[c->callee]->isGen)
+      fatal("for ... in expects a range a..b or a call to a gen fn");
+    if (sf->parallel) fatal("a parallel for cannot consume a generator");
+    if (!sf->reductions.empty()) fatal("reduce(...) requires a parallel for");
+    genCallOk = true;
+    auto vt = infer(*c);
+    if (curEffects) curEffects->loops = true; // the generator decides when the loop ends
+    scope.push(); {
+      scope.declare(sf->var, std::move(vt), false, false, true);
+      loopDepth++;
+      for (auto& st: sf->body) checkStmt(*st, currentRet);
+      loopDepth--;
+    }
+    scope.pop();
+    return;
+  }
+  if (auto *sf = dynamic_cast<SFor*>(&s)){
+    // the variable takes the bounds' integer type; a literal bound adopts the other's width
+    auto ft = infer(*sf->from), tt = infer(*sf->to);
+    if (!isInt(*ft) || !isInt(*tt)) fatal("for bounds must be integers, got "+ft->str()+" and "+tt->str());
+    auto vt = coerce(*sf->to, *tt, *ft) ? ft->clone() : coerce(*sf->from, *ft, *tt) ? tt->clone() : Type::i64();
+    if (sf->step){
+      auto st = infer(*sf->step);
+      if (!isInt(*st)) fatal("for step must be an integer");
+      sf->stepValue = ceval.eval(*sf->step).v;
+      if (sf->stepValue<=0) fatal("for step must be a positive constant");
+      coerce(*sf->step, *st, *vt);
+    }
+    if (sf->parallel){
+      for (auto& r : sf->reductions){
+        auto vi = scope.lookup(r.var);
+        if (!vi) fatal("unknown reduction variable '"+r.var+"'");
+        if (!isInt(*vi->ty) || vi->readOnly) fatal("reduction variable '"+r.var+"' must be an integer local");
+        for (auto& q : sf->reductions) if (&q!=&r && q.var==r.var) fatal("'"+r.var+"' is reduced twice");
+        noteCapture(r.var);
+      }
+      if (curEffects) curEffects->callees.push_back("aurora_parallel_for");
+    } else if (!sf->reductions.empty()) fatal("reduce(...) requires a parallel for");
+    scope.push(); {
+      scope.declare(sf->var, std::move(vt), false, false, true);
+      loopDepth++;
+      if (sf->parallel){
+        parallel.push_back({sf, (int)scope.stack.size()-1, loopDepth});
+        for (auto& r : sf->reductions) sf->captures.push_back(r.var);
+      }
+      // no `loops` effect: the trip count is bounded, so the loop always terminates
+      for (auto& st: sf->body) checkStmt(*st, currentRet);
+      if (sf->parallel) parallel.pop_back();
+      loopDepth--;
+    }
+    scope.pop();
+    return;
+  }
   if (auto *sw = dynamic_cast<SWhile*>(&s)){
-    { auto t = infer(*sw->cond); requireNonVoid(*t, "while condition"); }
+    { auto t = infer(*sw->cond); requireValue(*t, "while condition"); }
     scope.push(); {
-      std::vector<Expr*> localDefers;
       loopDepth++;  // Enter loop
-      for (auto& st: sw->body) checkStmt(*st, currentRet, localDefers);
+      if (curEffects) curEffects->loops = true;
+      for (auto& st: sw->body) checkStmt(*st, currentRet);
       loopDepth--;  // Exit loop
     }
     scope.pop();
@@ -190,13 +1081,32 @@ void Sema::checkStmt(Stmt& s, const Type* currentRet, std::vector<Expr*>& defers
   }
 
   if (auto *sd = dynamic_cast<SDefer*>(&s)){
-    // defer accepts void calls or value-producing expressions; type-checked above
-    defers.push_back(sd->e.get());
+    if (currentFn && currentFn->isConst) fatal("defer is not allowed in const fn");
+    if (currentFn && currentFn->isGen) fatal("defer is not allowed in gen fn");
+    // defer accepts void calls or value-producing expressions; CodeGen runs it at every exit of the block
+    inDefer = true;
+    (void)infer(*sd->e);
+    inDefer = false;
     return;
   }
   
+  if (auto *sy = dynamic_cast<SYield*>(&s)){
+    if (!currentFn || !currentFn->isGen) fatal("yield outside of a gen fn");
+    if (!parallel.empty()) fatal("yield is not allowed in a parallel for");
+    auto t = infer(*sy->e);
+    rejectVecCopy(*sy->e, *t);
+    if (!coerce(*sy->e, *t, *currentRet))
+      fatal("yield type mismatch, expected "+currentRet->str()+" got "+t->str());
+    return;
+  }
+  if (dynamic_cast<SSync*>(&s)){
+    if (!parallel.empty()) fatal("sync is not allowed in a parallel for");
+    if (curEffects) curEffects->callees.push_back("aurora_sync");
+    return;
+  }
   if (dynamic_cast<SBreak*>(&s)){
     if (loopDepth == 0) fatal("break statement outside of loop");
+    if (!parallel.empty() && parallel.back().loopDepth==loopDepth) fatal("break is not allowed in a parallel for");
     return;
   }
   
@@ -209,24 +1119,124 @@ void Sema::checkStmt(Stmt& s, const Type* currentRet, std::vector<Expr*>& defers
 void Sema::analyze(Program& p){
   primaries();
 
+  for (auto& s : p.structs){
+    if (structs.count(s->name)) fatal("redeclaration of struct: "+s->name);
+    structs[s->name] = s.get();
+  }
+  for (auto& s : p.structs){ std::vector<std::string> path; checkStruct(*s, path); }
+
+  // constants and const fns are evaluated lazily, so register them before anything is resolved
+  for (auto& c : p.consts){
+    if (consts.count(c->name)) fatal("redeclaration of constant: "+c->name);
+    consts[c->name] = c.get();
+  }
+  for (auto& fn : p.funcs) if (fn->isConst) constFns[fn->name] = fn.get();
+  for (auto& fn : p.funcs) userFns[fn->name] = fn.get();
+
   // gather function signatures
   for (auto& fn : p.funcs){
     FnSig sig;
     for (auto& pr : fn->params){
+      resolveType(*pr.ty);
       if (pr.ty->k == TyKind::Void)
         fatal("parameter '"+pr.name+"' cannot have type void");
+      if (fn->isConst && (pr.ty->k == TyKind::Ptr || pr.ty->k == TyKind::Slice || pr.ty->k == TyKind::Vec))
+        fatal("const fn '"+fn->name+"' cannot take pointer parameter '"+pr.name+"'");
+      if (pr.ty->k == TyKind::Atomic)
+        fatal("parameter '"+pr.name+"' cannot be "+pr.ty->str()+"; pass an array or pointer of atomics");
       sig.params.push_back(pr.ty->clone());
     }
+    resolveType(*fn->ret);
+    if (fn->ret->k == TyKind::Atomic) fatal("function '"+fn->name+"' cannot return "+fn->ret->str());
+    if (fn->isGen){
+      auto k = fn->ret->k;
+      if (fn->name=="main") fatal("main cannot be a gen fn");
+      if (k==TyKind::Void || k==TyKind::Array || k==TyKind::Vec || k==TyKind::Future || k==TyKind::Chan)
+        fatal("gen fn '"+fn->name+"' cannot yield "+fn->ret->str());
+    }
     sig.ret = fn->ret->clone();
+    sig.isConst = fn->isConst;
     fns[fn->name] = std::move(sig);
   }
 
+  // evaluate and type-check constants
+  for (auto& c : p.consts){
+    constValue(c->name);
+    auto t = infer(*c->init);
+    auto& declared = constType(*c);
+    if (!constCompatible(declared, *t))
+      fatal("type mismatch in constant '"+c->name+"': "+declared.str()+" vs "+t->str());
+    ceval.coerce(c->value, declared);
+  }
+
   // type-check bodies
   for (auto& fn : p.funcs){
+    currentFn = fn.get();
+    curEffects = &effects[fn->name];
     scope.push();
-    for (auto& pr : fn->params) scope.declare(pr.name, pr.ty->clone());
-    std::vector<Expr*> defers;
-    for (auto& st : fn->body) checkStmt(*st, fn->ret.get(), defers);
+    for (auto& pr : fn->params) scope.declare(pr.name, pr.ty->clone(), false, pr.ty->k==TyKind::Array);
+    sawSpawn = false;
+    if (fn->isGen) curEffects->callees.push_back("aurora_gen_frame"); // allocates its frame, suspends
+    for (auto& st : fn->body) checkStmt(*st, fn->ret.get());
+    fn->spawns = sawSpawn;
     scope.pop();
   }
+  currentFn = nullptr;
+  curEffects = nullptr;
+
+  // reference parameters never handed overlapping storage may be marked noalias
+  for (auto& fn : p.funcs){
+    auto it = refArgsDistinct.find(fn->name);
+    for (size_t k=0; k<fn->params.size(); ++k){
+      auto pk = fn->params[k].ty->k;
+      if (pk!=TyKind::Array && pk!=TyKind::Slice) continue;
+      fn->params[k].noalias = it==refArgsDistinct.end() || it->second[k];
+    }
+  }
+
+  inferEffects(p);
+}
+
+void Sema::inferEffects(Program& p){
+  std::unordered_map<std::string, Func*> user;
+  for (auto& fn : p.funcs) user[fn->name] = fn.get();
+
+  // recursive: the function can reach itself through the call graph
+  for (auto& fn : p.funcs){
+    std::vector<std::string> work(effects[fn->name].callees);
+    std::unordered_map<std::string, bool> seen;
+    bool rec = false;
+    while (!work.empty() && !rec){
+      auto g = work.back(); work.pop_back();
+      if (!user.count(g) || seen[g]) continue;
+      seen[g] = true;
+      if (g==fn->name) rec = true;
+      for (auto& h : effects[g].callees) work.push_back(h);
+    }
+    fn->effects.recursive = rec;
+  }
+
+  // optimistic start, then weaken until nothing changes; builtins do I/O or allocate
+  for (auto& fn : p.funcs){
+    auto& le = effects[fn->name];
+    auto& fx = fn->effects;
+    fx.readOnly = !le.writesMem;
+    fx.pure = fx.readOnly && !le.readsMem;
+    fx.willReturn = !le.loops && !fx.recursive;
+    for (auto& g : le.callees)
+      if (!user.count(g)) fx.pure = fx.readOnly = fx.willReturn = false;
+  }
+  for (bool changed=true; changed; ){
+    changed = false;
+    for (auto& fn : p.funcs){
+      auto& fx = fn->effects;
+      for (auto& g : effects[fn->name].callees){
+        auto it = user.find(g);
+        if (it==user.end()) continue;
+        auto& gx = it->second->effects;
+        bool pure = fx.pure && gx.pure, ro = fx.readOnly && gx.readOnly, wr = fx.willReturn && gx.willReturn;
+        if (pure!=fx.pure || ro!=fx.readOnly || wr!=fx.willReturn){ fx.pure=pure; fx.readOnly=ro; fx.willReturn=wr; changed=true; }
+      }
+    }
+  }
 }
@@ -2,16 +2,67 @@
 #pragma once
 #include "ast.h"
 #include "scope.h"
+#include "consteval.h"
 
-struct FnSig { std::vector<std::unique_ptr<Type>> params; std::unique_ptr<Type> ret; };
+struct FnSig { std::vector<std::unique_ptr<Type>> params; std::unique_ptr<Type> ret; bool isConst=false; };
+
+// Facts about one function body, gathered while type-checking it.
+struct LocalEffects {
+  bool readsMem=false, writesMem=false; // through pointers
+  bool loops=false;
+  std::vector<std::string> callees;
+};
 
 struct Sema {
   Scope scope;
   std::unordered_map<std::string, FnSig> fns;
+  std::unordered_map<std::string, Func*> constFns;
+  std::unordered_map<std::string, ConstDecl*> consts;
+  std::unordered_map<std::string, StructDecl*> structs;
+  std::unordered_map<std::string, Func*> userFns;
   int loopDepth = 0;  // Track loop nesting for break/continue validation
+  const Func* currentFn = nullptr;
+  ConstEval ceval{*this};
   void primaries(); // install builtins
   void analyze(Program& p);
+  void resolveType(Type& t); // fold constant array sizes, check struct names
+  bool isSoa(const Type& elem) const; // elements of this type are stored column-wise
+  const ConstValue* constValue(const std::string& name); // evaluates on first use; null if not a const
 private:
-  std::unique_ptr<Type> infer(Expr& e);
-  void checkStmt(Stmt& s, const Type* currentRet, std::vector<Expr*>& defers);
+  std::unordered_map<std::string, int> constState; // 1 = evaluating, 2 = done
+  std::unordered_map<std::string, LocalEffects> effects;
+  LocalEffects* curEffects = nullptr;
+  std::unordered_map<std::string, std::vector<bool>> refArgsDistinct; // per callee/param, over all call sites
+  bool throughRef(Expr& base);   // indexing base reaches memory the function does not own
+  const void* refRoot(Expr& arg); // storage a reference argument denotes; null if unknown
+  void noteRefArgs(ECall& c, const FnSig& sig);
+  std::unique_ptr<Type> inferVecOp(ECall& c); // push/pop/reserve/free on a vec; null otherwise
+  std::unique_ptr<Type> inferSimdOp(ECall& c); // simd constructors, load/store, shuffles, reductions
+  std::unique_ptr<Type> inferAtomicOp(ECall& c); // atomic<T>(v), load/store/fetch_*/exchange/cas on atomics
+  bool hasAtomic(const Type& t); // t is or contains an atomic<T>
+  bool hasVec(const Type& t); // t is or contains a vec<T>
+  void rejectVecCopy(Expr& e, const Type& t); // e names a value of type t whose copy would share an owner
+  std::unique_ptr<Type> inferChanOp(ECall& c); // send/recv/try_send/try_recv/free on a chan
+  std::unique_ptr<Type> inferArenaOp(ECall& c); // arena_new/arena_alloc<T>/arena_mark/arena_reset/arena_free
+  std::unique_ptr<Type> inferFileOp(ECall& c); // map_array<T>(path, hints...), unmap(s), write_array_bin(path, src, n)
+  bool isPlainData(const Type& t); // bytes of a file can be viewed as a t: no pointers, bools or handles
+  std::unique_ptr<Type> inferSimdBin(EBin& bin, std::unique_ptr<Type> lt, std::unique_ptr<Type> rt);
+  // enclosing parallel for loops, innermost last; locals declared in scopes below `depth`
+  // are shared by all of a loop's iterations
+  struct ParallelCtx { SFor* loop; int depth; int loopDepth; };
+  std::vector<ParallelCtx> parallel;
+  void noteCapture(const std::string& name);
+  bool sawSpawn = false; // the function being checked contains spawn
+  bool genCallOk = false; // the next call inferred is a for loop's generator source
+  bool indexBaseOk = false; // the next variable inferred is the base of an index, p[i]
+  bool inDefer = false; // checking a defer, which runs after any later store in its block
+  void checkShared(Expr& target, const std::string& action); // reject races on shared locals
+  std::string allocOrigin(Expr& e); // builtin allocator e's pointer visibly comes from; empty if unknown
+  void inferEffects(Program& p);
+  std::unique_ptr<Type> infer(Expr& e);     // also records the type on e.ty
+  std::unique_ptr<Type> inferExpr(Expr& e);
+  bool coerce(Expr& e, const Type& from, const Type& to);
+  const Type& constType(ConstDecl& c);
+  void checkStruct(StructDecl& s, std::vector<std::string>& path);
+  void checkStmt(Stmt& s, const Type* currentRet);
 };
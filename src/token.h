@@ -3,10 +3,10 @@
 #include <cstdint>
 
 enum class TokKind {
-  Eof, Ident, IntLit, True, False,
-  KwLet, KwFn, KwIf, KwElse, KwWhile, KwReturn, KwDefer, KwBreak, KwContinue,
+  Eof, Ident, IntLit, StrLit, True, False,
+  KwLet, KwConst, KwFn, KwExport, KwStruct, KwIf, KwElse, KwWhile, KwFor, KwReturn, KwDefer, KwBreak, KwContinue,
   KwI32, KwI64, KwBool, KwPtr, KwUnique, KwVoid,
-  LParen, RParen, LBrace, RBrace, LBracket, RBracket, Comma, Colon, Semicolon, Arrow,
+  LParen, RParen, LBrace, RBrace, LBracket, RBracket, Comma, Colon, Semicolon, Arrow, Dot, DotDot, Hash,
   Plus, Minus, Star, Slash, Percent,
   Bang, AmpAmp, PipePipe,
   Eq, EqEq, BangEq, Lt, Le, Gt, Ge,
@@ -8,13 +8,22 @@ std::string Type::str() const {
     case TyKind::Void: return "void";
     case TyKind::Ptr: return "ptr<"+ (elem? elem->str() : "?") +">";
     case TyKind::Array: return (elem? elem->str() : "?") + "[" + std::to_string(arraySize) + "]";
+    case TyKind::Slice: return "[]" + (elem? elem->str() : "?");
+    case TyKind::Struct: return name;
+    case TyKind::Simd: return "simd<" + (elem? elem->str() : "?") + "," + std::to_string(arraySize) + ">";
+    case TyKind::Vec: return "vec<"+ (elem? elem->str() : "?") +">";
+    case TyKind::Future: return "future<"+ (elem? elem->str() : "?") +">";
+    case TyKind::Atomic: return "atomic<"+ (elem? elem->str() : "?") +">";
+    case TyKind::Chan: return "chan<"+ (elem? elem->str() : "?") +">";
+    case TyKind::Arena: return "arena";
   }
   return "?";
 }
 bool Type::equals(const Type& o) const {
   if (k!=o.k) return false;
-  if (k==TyKind::Ptr) return elem && o.elem && elem->equals(*o.elem);
-  if (k==TyKind::Array) return arraySize==o.arraySize && elem && o.elem && elem->equals(*o.elem);
+  if (k==TyKind::Ptr || k==TyKind::Slice || k==TyKind::Vec || k==TyKind::Future || k==TyKind::Atomic || k==TyKind::Chan) return elem && o.elem && elem->equals(*o.elem);
+  if (k==TyKind::Struct) return name==o.name;
+  if (k==TyKind::Array || k==TyKind::Simd) return arraySize==o.arraySize && elem && o.elem && elem->equals(*o.elem);
   return true;
 }
 
@@ -22,5 +31,7 @@ std::unique_ptr<Type> Type::clone() const {
   auto t = std::make_unique<Type>(k);
   if (elem) t->elem = elem->clone();
   t->arraySize = arraySize;
+  t->sizeExpr = sizeExpr;
+  t->name = name;
   return t;
 }
\ No newline at end of file
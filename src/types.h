@@ -4,12 +4,16 @@
 #include <string>
 #include <vector>
 
-enum class TyKind { I32, I64, Bool, Ptr, Array, Void };
+struct Expr;
+
+enum class TyKind { I32, I64, Bool, Ptr, Array, Slice, Vec, Struct, Simd, Future, Atomic, Chan, Arena, Void };
 
 struct Type {
   TyKind k;
-  std::unique_ptr<Type> elem; // for Ptr<T> and Array<T>
-  int64_t arraySize = 0; // for Array types
+  std::unique_ptr<Type> elem; // for Ptr<T>, Array<T>, Slice<T>, Vec<T>, Simd<T,N>, Future<T>, Atomic<T> and Chan<T>
+  int64_t arraySize = 0; // for Array types; lane count for Simd
+  std::shared_ptr<Expr> sizeExpr; // non-literal array size; folded into arraySize by Sema
+  std::string name; // for Struct
   explicit Type(TyKind k):k(k){}
   static std::unique_ptr<Type> i32(){ return std::make_unique<Type>(TyKind::I32); }
   static std::unique_ptr<Type> i64(){ return std::make_unique<Type>(TyKind::I64); }
@@ -17,6 +21,14 @@ struct Type {
   static std::unique_ptr<Type> voidty(){ return std::make_unique<Type>(TyKind::Void); }
   static std::unique_ptr<Type> ptr(std::unique_ptr<Type> t){ auto p=std::make_unique<Type>(TyKind::Ptr); p->elem=std::move(t); return p; }
   static std::unique_ptr<Type> array(std::unique_ptr<Type> t, int64_t size){ auto a=std::make_unique<Type>(TyKind::Array); a->elem=std::move(t); a->arraySize=size; return a; }
+  static std::unique_ptr<Type> slice(std::unique_ptr<Type> t){ auto s=std::make_unique<Type>(TyKind::Slice); s->elem=std::move(t); return s; }
+  static std::unique_ptr<Type> simd(std::unique_ptr<Type> t, int64_t lanes){ auto v=std::make_unique<Type>(TyKind::Simd); v->elem=std::move(t); v->arraySize=lanes; return v; }
+  static std::unique_ptr<Type> structTy(std::string n){ auto s=std::make_unique<Type>(TyKind::Struct); s->name=std::move(n); return s; }
+  static std::unique_ptr<Type> vec(std::unique_ptr<Type> t){ auto v=std::make_unique<Type>(TyKind::Vec); v->elem=std::move(t); return v; }
+  static std::unique_ptr<Type> atomic(std::unique_ptr<Type> t){ auto a=std::make_unique<Type>(TyKind::Atomic); a->elem=std::move(t); return a; }
+  static std::unique_ptr<Type> chan(std::unique_ptr<Type> t){ auto c=std::make_unique<Type>(TyKind::Chan); c->elem=std::move(t); return c; }
+  static std::unique_ptr<Type> arena(){ return std::make_unique<Type>(TyKind::Arena); }
+  static std::unique_ptr<Type> future(std::unique_ptr<Type> t){ auto f=std::make_unique<Type>(TyKind::Future); f->elem=std::move(t); return f; }
   std::string str() const;
   bool equals(const Type& o) const;
   std::unique_ptr<Type> clone() const;  // Deep copy method
@@ -1,7 +1,1342 @@
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 
-int64_t print_i64(int64_t x) { printf("%lld\n", (long long)x); return x; }
-int64_t read_i64(void) { long long x; if (scanf("%lld", &x)!=1) return 0; return (int64_t)x; }
-/* malloc/free are imported from libc */
+/* malloc/free are imported from libc; print_i64/read_i64 and the file builtins are at the end (I/O, Files) */
+
+/* vec<T> header; CodeGen lays it out as { ptr, i64, i64 } and inlines push/pop/len. */
+typedef struct { void* data; int64_t len; int64_t cap; } aurora_vec;
+
+/* Buffers at least this large get their own mapping so growth can mremap instead of copying. */
+#define AURORA_VEC_MAP_MIN ((size_t)1 << 20)
+
+static size_t page_round(size_t n) { return (n + 4095) & ~(size_t)4095; }
+
+static void vec_oom(void) { fputs("aurora: out of memory growing vec\n", stderr); abort(); }
+
+static int vec_mapped(size_t bytes) {
+#ifdef __linux__
+  return bytes >= AURORA_VEC_MAP_MIN;
+#else
+  (void)bytes; return 0;
+#endif
+}
+
+/* A buffer of `bytes` comes from malloc or its own mapping depending on size; the two must agree. */
+static void* vec_alloc(size_t bytes) {
+#ifdef __linux__
+  if (vec_mapped(bytes)) {
+    void* p = mmap(NULL, page_round(bytes), PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    return p == MAP_FAILED ? NULL : p;
+  }
+#endif
+  return malloc(bytes);
+}
+
+static void vec_release(void* p, size_t bytes) {
+#ifdef __linux__
+  if (vec_mapped(bytes)) { if (p) munmap(p, page_round(bytes)); return; }
+#endif
+  free(p);
+}
+
+/* Capacity after growing from `old` (`first` when empty) to at least `need` elements of `elem`
+   bytes, and its size in *bytes: double, or exactly `need` when the double would not fit in
+   memory; a `need` that does not fit either is out of memory. */
+static int64_t vec_next_cap(int64_t old, int64_t first, int64_t need, int64_t elem, size_t* bytes) {
+  int64_t cap = old ? (old > INT64_MAX / 2 ? INT64_MAX : old * 2) : first;
+  if (cap < need) cap = need;
+  if (!__builtin_mul_overflow((size_t)cap, (size_t)elem, bytes) && *bytes <= PTRDIFF_MAX) return cap;
+  if (__builtin_mul_overflow((size_t)need, (size_t)elem, bytes) || *bytes > PTRDIFF_MAX) vec_oom();
+  return need;
+}
+
+/* Grow v to hold at least `need` elements of `esz` bytes; doubles so pushes stay amortized O(1). */
+void aurora_vec_grow(aurora_vec* v, int64_t esz, int64_t need) {
+  if (need <= v->cap) return;
+  size_t oldBytes = (size_t)v->cap * (size_t)esz, bytes;
+  int64_t cap = vec_next_cap(v->cap, esz < 16 ? 64 / esz : 4, need, esz, &bytes);
+  void* p;
+#ifdef __linux__
+  if (vec_mapped(bytes)) {
+    if (vec_mapped(oldBytes)) {
+      p = mremap(v->data, page_round(oldBytes), page_round(bytes), MREMAP_MAYMOVE);
+      if (p == MAP_FAILED) vec_oom();
+    } else {
+      p = vec_alloc(bytes);
+      if (!p) vec_oom();
+      if (v->len) memcpy(p, v->data, (size_t)v->len * (size_t)esz);
+      free(v->data);
+    }
+  } else
+#endif
+  {
+    p = realloc(v->data, bytes);
+    if (!p) vec_oom();
+  }
+  v->data = p;
+  v->cap = cap;
+}
+
+/* soa vec: columns of colSize[k] bytes lie back to back, column k at data + cap * sum(colSize[<k]).
+   Growing moves every column to its offset in the new buffer. */
+void aurora_vec_grow_soa(aurora_vec* v, const int64_t* colSize, int64_t ncols, int64_t need) {
+  if (need <= v->cap) return;
+  int64_t row = 0; /* column sizes are type sizes from CodeGen, so their sum cannot overflow */
+  for (int64_t k = 0; k < ncols; ++k) row += colSize[k];
+  size_t bytes;
+  int64_t cap = vec_next_cap(v->cap, 16, need, row, &bytes);
+  char* p = vec_alloc(bytes);
+  if (!p) vec_oom();
+  size_t off = 0;
+  for (int64_t k = 0; k < ncols; ++k) {
+    if (v->len) memcpy(p + (size_t)cap * off, (char*)v->data + (size_t)v->cap * off, (size_t)v->len * (size_t)colSize[k]);
+    off += (size_t)colSize[k];
+  }
+  vec_release(v->data, (size_t)v->cap * (size_t)row);
+  v->data = p;
+  v->cap = cap;
+}
+
+void aurora_vec_free(aurora_vec* v, int64_t esz) {
+  vec_release(v->data, (size_t)v->cap * (size_t)esz);
+  v->data = NULL; v->len = 0; v->cap = 0;
+}
+
+void aurora_vec_pop_empty(void) { fputs("aurora: pop from empty vec\n", stderr); abort(); }
+
+/* Arenas: bump allocation from a chain of malloc'd chunks, all released together. CodeGen lays
+   out the first two fields and inlines arena_alloc: align cur up and, if the request fits below
+   end, advance cur. end is kept 64-byte aligned so aligning cur never passes it. */
+typedef struct arena_chunk { struct arena_chunk* prev; char* end; } arena_chunk; /* data follows */
+typedef struct {
+  char* cur;
+  char* end;
+  arena_chunk* chunk; /* current chunk; older ones through prev */
+  arena_chunk* spare; /* largest chunk a reset released, reused by the next growth */
+  size_t next;        /* data bytes for the next chunk; doubles up to ARENA_MAX */
+} aurora_arena;
+
+#define ARENA_MIN ((size_t)1 << 16)
+#define ARENA_MAX ((size_t)1 << 26)
+
+static void arena_fail(const char* msg) { fprintf(stderr, "aurora: %s\n", msg); abort(); }
+
+static char* chunk_data(arena_chunk* c) { return (char*)(c + 1); }
+static size_t chunk_size(arena_chunk* c) { return (size_t)(c->end - chunk_data(c)); }
+
+static arena_chunk* chunk_new(size_t bytes) {
+  arena_chunk* c = malloc(sizeof *c + bytes);
+  if (!c) arena_fail("out of memory in arena");
+  c->end = (char*)((uintptr_t)(chunk_data(c) + bytes) & ~(uintptr_t)63);
+  return c;
+}
+
+static void arena_use(aurora_arena* a, arena_chunk* c) {
+  c->prev = a->chunk;
+  a->chunk = c;
+  a->cur = chunk_data(c);
+  a->end = c->end;
+}
+
+/* Keep the larger of c and the current spare; free the other. */
+static void arena_retire(aurora_arena* a, arena_chunk* c) {
+  if (a->spare && chunk_size(a->spare) >= chunk_size(c)) { free(c); return; }
+  free(a->spare);
+  a->spare = c;
+}
+
+aurora_arena* aurora_arena_new(int64_t chunk) {
+  aurora_arena* a = calloc(1, sizeof *a);
+  if (!a) arena_fail("out of memory in arena");
+  a->next = chunk > 0 ? (size_t)chunk + 64 : ARENA_MIN;
+  arena_use(a, chunk_new(a->next));
+  if (a->next < ARENA_MAX) a->next *= 2;
+  return a;
+}
+
+/* The current chunk cannot take n elements of size bytes at this alignment (or the alignment
+   is above 64): continue in the spare or a new chunk. The old chunk's tail stays unused. */
+void* aurora_arena_grow(aurora_arena* a, int64_t n, int64_t size, int64_t align) {
+  size_t bytes;
+  if (n < 0 || __builtin_mul_overflow((size_t)n, (size_t)size, &bytes)) arena_fail("arena_alloc: invalid count");
+  uintptr_t mask = (uintptr_t)align - 1;
+  char* p = (char*)(((uintptr_t)a->cur + mask) & ~mask);
+  if (p <= a->end && bytes <= (size_t)(a->end - p)) { a->cur = p + bytes; return p; }
+  size_t need = bytes + (size_t)align + 64;
+  if (need < bytes) arena_fail("out of memory in arena");
+  arena_chunk* c = a->spare;
+  if (c && chunk_size(c) >= need) a->spare = NULL;
+  else {
+    c = chunk_new(need > a->next ? need : a->next);
+    if (a->next < ARENA_MAX) a->next *= 2;
+  }
+  arena_use(a, c);
+  p = (char*)(((uintptr_t)a->cur + mask) & ~mask);
+  a->cur = p + bytes;
+  return p;
+}
+
+/* Rewinds to a mark from arena_mark, or to empty when mark is 0. Chunks above the mark are
+   released except the largest, kept as the spare; a full reset continues in that chunk. */
+void aurora_arena_reset(aurora_arena* a, int64_t mark) {
+  char* m = (char*)(uintptr_t)mark;
+  while (a->chunk) {
+    arena_chunk* c = a->chunk;
+    if (m && m >= chunk_data(c) && m <= c->end) { a->cur = m; a->end = c->end; return; }
+    a->chunk = c->prev;
+    arena_retire(a, c);
+  }
+  if (m) arena_fail("arena_reset: mark does not belong to this arena");
+  arena_chunk* c = a->spare;
+  a->spare = NULL;
+  arena_use(a, c);
+}
+
+void aurora_arena_free(aurora_arena* a) {
+  if (!a) return;
+  while (a->chunk) {
+    arena_chunk* c = a->chunk;
+    a->chunk = c->prev;
+    free(c);
+  }
+  free(a->spare);
+  free(a);
+}
+
+/* Pools: per-thread free lists of fixed-size nodes, one per 16-byte size class up to 256 bytes.
+   CodeGen picks the class from sizeof(T) and inlines pop and push on aurora_pool_heads; an
+   empty list is refilled from a new 64-byte-aligned slab, carved in address order so nodes
+   allocated together sit together. Slabs are never returned: a node freed on another thread
+   joins that thread's list. */
+#define POOL_CLASSES 16
+#define POOL_SLAB ((size_t)1 << 16)
+
+__attribute__((tls_model("initial-exec"))) _Thread_local void* aurora_pool_heads[POOL_CLASSES];
+
+void* aurora_pool_refill(int64_t cls) {
+  size_t size = (size_t)(cls + 1) * 16, n = POOL_SLAB / size;
+  char* slab = aligned_alloc(64, POOL_SLAB);
+  if (!slab) { fputs("aurora: out of memory in pool_alloc\n", stderr); abort(); }
+  for (size_t i = 1; i + 1 < n; ++i) *(void**)(slab + i * size) = slab + (i + 1) * size;
+  *(void**)(slab + (n - 1) * size) = NULL;
+  aurora_pool_heads[cls] = slab + size; /* node 0 goes to the caller */
+  return slab;
+}
+
+/* Large arrays: anonymous mappings, which read as zero until first written, so no page is
+   touched twice. The data starts LARGE_HEAD bytes in, after a header holding the mapping's
+   length, which keeps it 64-byte aligned. With hugepages a region of 2 MiB or more is placed
+   on a 2 MiB boundary, rounded up to whole huge pages and advised MADV_HUGEPAGE, so
+   transparent huge pages can back all of it. */
+#define LARGE_HEAD 64
+#define HUGE_PAGE ((size_t)2 << 20)
+
+static void large_fail(const char* msg) { fprintf(stderr, "aurora: %s\n", msg); abort(); }
+
+void* aurora_alloc_large(int64_t n, int64_t size, int32_t hugepages) {
+  size_t bytes, len;
+  if (n < 0 || __builtin_mul_overflow((size_t)n, (size_t)size, &bytes) ||
+      __builtin_add_overflow(bytes, (size_t)LARGE_HEAD + HUGE_PAGE, &len))
+    large_fail("alloc_large: invalid count");
+  len = bytes + LARGE_HEAD;
+  size_t page = (size_t)sysconf(_SC_PAGESIZE);
+  size_t align = hugepages && len >= HUGE_PAGE ? HUGE_PAGE : page;
+  len = (len + align - 1) & ~(align - 1);
+  size_t map = len + align - page; /* room to slide to an aligned start */
+  char* base = mmap(NULL, map, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (base == MAP_FAILED) large_fail("out of memory in alloc_large");
+  char* p = (char*)(((uintptr_t)base + align - 1) & ~(uintptr_t)(align - 1));
+  if (p > base) munmap(base, (size_t)(p - base));
+  if (p + len < base + map) munmap(p + len, (size_t)(base + map - (p + len)));
+#ifdef MADV_HUGEPAGE
+  if (align == HUGE_PAGE) madvise(p, len, MADV_HUGEPAGE);
+#endif
+  *(size_t*)p = len;
+  return p + LARGE_HEAD;
+}
+
+void aurora_free_large(void* data) {
+  if (!data) return;
+  char* p = (char*)data - LARGE_HEAD;
+  munmap(p, *(size_t*)p);
+}
+
+/* --alloc-profile: CodeGen sends heap allocations through these hooks with the source line of
+   the call. A block gets a PROF_HEAD-byte header {bytes, site} so its free finds the site;
+   alloc_large keeps both in its own header. A fixed open-addressed table numbers the lines
+   densely in order of first use; each thread counts into its own counters, allocated
+   PROF_CHUNK sites at a time when one of them is first used, so the only shared writes are
+   the live byte total and, when it rises past it, the peak. arena_alloc and pool_alloc are
+   counted at their line through aurora_prof_note but have no individual frees, so live bytes
+   cover the heap only. The report goes to stderr, or to the file AURORA_ALLOC_PROFILE names,
+   at exit. */
+#define PROF_SITES 1024   /* power of two; one more slot collects lines that do not fit */
+#define PROF_BUCKETS 48   /* allocation sizes in [2^k, 2^(k+1)) bytes, reported as lo-hi; 0 counts as 1 */
+#define PROF_CHUNK 16     /* sites per block of a thread's counters */
+#define PROF_HEAD 16
+
+typedef struct { int64_t bytes, heap, frees, freed, hist[PROF_BUCKETS]; } prof_count; /* heap: bytes that get freed individually */
+typedef struct prof_thread { struct prof_thread* next; prof_count* chunk[PROF_SITES / PROF_CHUNK + 1]; } prof_thread;
+
+static _Atomic int64_t prof_lines[PROF_SITES]; /* line << 16 | (site + 1); 0: unused */
+static _Atomic int64_t prof_nsites;           /* site numbers handed out */
+static _Atomic int64_t prof_live_bytes, prof_peak_bytes;
+__attribute__((tls_model("initial-exec"))) static _Thread_local prof_thread* prof_mine;
+static prof_thread* prof_threads; /* every thread's counters, kept until exit */
+static pthread_mutex_t prof_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t prof_once = PTHREAD_ONCE_INIT;
+static void prof_report(void);
+static void prof_init(void) { atexit(prof_report); }
+
+/* A thread that loses the race for an empty slot leaves the number it took unused. */
+static int64_t prof_site_of(int64_t line) {
+  if (line <= 0 || line >= (int64_t)1 << 47) return PROF_SITES;
+  size_t h = (size_t)((uint64_t)line * 0x9E3779B97F4A7C15u >> 54);
+  for (size_t k = 0; k < PROF_SITES; ++k) {
+    size_t i = (h + k) & (PROF_SITES - 1);
+    int64_t cur = atomic_load_explicit(&prof_lines[i], memory_order_acquire);
+    if (cur == 0) {
+      int64_t site = atomic_fetch_add_explicit(&prof_nsites, 1, memory_order_relaxed);
+      if (site >= PROF_SITES) return PROF_SITES;
+      if (atomic_compare_exchange_strong(&prof_lines[i], &cur, line << 16 | (site + 1))) return site;
+    }
+    if (cur >> 16 == line) return (cur & 0xFFFF) - 1;
+  }
+  return PROF_SITES;
+}
+
+static void* prof_calloc(size_t n, size_t size) {
+  void* p = calloc(n, size);
+  if (!p) { fputs("aurora: out of memory in alloc profile\n", stderr); abort(); }
+  return p;
+}
+
+static prof_count* prof_counts(int64_t site) {
+  prof_thread* t = prof_mine;
+  if (!t) {
+    pthread_once(&prof_once, prof_init);
+    t = prof_calloc(1, sizeof *t);
+    pthread_mutex_lock(&prof_lock);
+    t->next = prof_threads;
+    prof_threads = t;
+    pthread_mutex_unlock(&prof_lock);
+    prof_mine = t;
+  }
+  prof_count** c = &t->chunk[site / PROF_CHUNK];
+  if (!*c) *c = prof_calloc(PROF_CHUNK, sizeof **c);
+  return &(*c)[site % PROF_CHUNK];
+}
+
+static void prof_live(int64_t delta) {
+  int64_t live = atomic_fetch_add_explicit(&prof_live_bytes, delta, memory_order_relaxed) + delta;
+  int64_t peak = atomic_load_explicit(&prof_peak_bytes, memory_order_relaxed);
+  while (live > peak && !atomic_compare_exchange_weak_explicit(&prof_peak_bytes, &peak, live, memory_order_relaxed,
+                                                              memory_order_relaxed)) {}
+}
+
+static void prof_count_alloc(int64_t site, int64_t bytes, int heap) {
+  prof_count* c = prof_counts(site);
+  int b = bytes > 1 ? 63 - __builtin_clzll((uint64_t)bytes) : 0;
+  c->bytes += bytes;
+  if (heap) { c->heap += bytes; prof_live(bytes); }
+  c->hist[b < PROF_BUCKETS ? b : PROF_BUCKETS - 1]++;
+}
+
+static void prof_count_free(int64_t site, int64_t bytes) {
+  prof_count* c = prof_counts(site);
+  c->frees++;
+  c->freed += bytes;
+  prof_live(-bytes);
+}
+
+static void* prof_track(int64_t* h, int64_t bytes, int64_t line) {
+  if (!h) return NULL;
+  h[0] = bytes;
+  h[1] = prof_site_of(line);
+  prof_count_alloc(h[1], bytes, 1);
+  return (char*)h + PROF_HEAD;
+}
+
+void* aurora_prof_malloc(int64_t bytes, int64_t line) {
+  if (bytes < 0 || (uint64_t)bytes > SIZE_MAX - PROF_HEAD) return NULL; /* what malloc would do */
+  return prof_track(malloc((size_t)bytes + PROF_HEAD), bytes, line);
+}
+
+void* aurora_prof_calloc(int64_t n, int64_t size, int64_t line) {
+  size_t bytes;
+  if (n < 0 || __builtin_mul_overflow((size_t)n, (size_t)size, &bytes) || bytes > SIZE_MAX - PROF_HEAD) return NULL;
+  return prof_track(calloc(1, bytes + PROF_HEAD), (int64_t)bytes, line);
+}
+
+void aurora_prof_free(void* p) {
+  if (!p) return;
+  int64_t* h = (int64_t*)((char*)p - PROF_HEAD);
+  prof_count_free(h[1], h[0]);
+  free(h);
+}
+
+void* aurora_prof_alloc_large(int64_t n, int64_t size, int32_t hugepages, int64_t line) {
+  char* p = aurora_alloc_large(n, size, hugepages);
+  int64_t* h = (int64_t*)(p - LARGE_HEAD); /* h[0] is the mapping's length */
+  h[1] = prof_site_of(line);
+  h[2] = n * size;
+  prof_count_alloc(h[1], h[2], 1);
+  return p;
+}
+
+void aurora_prof_free_large(void* p) {
+  if (!p) return;
+  int64_t* h = (int64_t*)((char*)p - LARGE_HEAD);
+  prof_count_free(h[1], h[2]);
+  aurora_free_large(p);
+}
+
+void aurora_prof_note(int64_t bytes, int64_t line) { prof_count_alloc(prof_site_of(line), bytes, 0); }
+
+typedef struct { int64_t line, allocs; prof_count c; } prof_row;
+
+static int prof_by_bytes(const void* a, const void* b) {
+  int64_t x = ((const prof_row*)a)->c.bytes, y = ((const prof_row*)b)->c.bytes;
+  return (x < y) - (x > y);
+}
+
+static const char* prof_size(int64_t v, char* buf, size_t n) {
+  static const char* unit[] = {"B", "K", "M", "G", "T"};
+  int u = 0;
+  while (u < 4 && v >= 1024 && v % 1024 == 0) { v /= 1024; ++u; }
+  snprintf(buf, n, "%lld%s", (long long)v, unit[u]);
+  return buf;
+}
+
+/* Runs at exit, when other threads are idle; their counters are read without synchronization. */
+static void prof_report(void) {
+  static prof_row rows[PROF_SITES + 1];
+  static int64_t line_of[PROF_SITES + 1];
+  for (size_t i = 0; i < PROF_SITES; ++i)
+    if (prof_lines[i]) line_of[(prof_lines[i] & 0xFFFF) - 1] = prof_lines[i] >> 16;
+  line_of[PROF_SITES] = -1;
+  size_t n = 0;
+  int64_t allocs = 0, bytes = 0;
+  for (size_t k = 0; k <= PROF_SITES; ++k) {
+    prof_row r = {line_of[k], 0, {0}};
+    for (prof_thread* t = prof_threads; t; t = t->next) {
+      if (!t->chunk[k / PROF_CHUNK]) continue;
+      prof_count* c = &t->chunk[k / PROF_CHUNK][k % PROF_CHUNK];
+      r.c.bytes += c->bytes;
+      r.c.heap += c->heap;
+      r.c.frees += c->frees;
+      r.c.freed += c->freed;
+      for (int b = 0; b < PROF_BUCKETS; ++b) { r.c.hist[b] += c->hist[b]; r.allocs += c->hist[b]; }
+    }
+    if (!r.allocs) continue;
+    allocs += r.allocs;
+    bytes += r.c.bytes;
+    rows[n++] = r;
+  }
+  qsort(rows, n, sizeof *rows, prof_by_bytes);
+  const char* path = getenv("AURORA_ALLOC_PROFILE");
+  FILE* out = path && *path ? fopen(path, "w") : NULL;
+  if (!out) out = stderr;
+  fprintf(out, "aurora alloc profile: %lld allocations, %lld bytes, peak live %lld bytes, live at exit %lld bytes\n",
+          (long long)allocs, (long long)bytes, (long long)prof_peak_bytes, (long long)prof_live_bytes);
+  fprintf(out, "%8s %12s %16s %12s %16s\n", "line", "allocs", "bytes", "frees", "live at exit");
+  for (size_t i = 0; i < n; ++i) {
+    prof_row* r = &rows[i];
+    char line[24], lo[24], hi[24];
+    if (r->line < 0) snprintf(line, sizeof line, "other");
+    else snprintf(line, sizeof line, "%lld", (long long)r->line);
+    fprintf(out, "%8s %12lld %16lld %12lld %16lld\n  sizes:", line, (long long)r->allocs, (long long)r->c.bytes,
+            (long long)r->c.frees, (long long)(r->c.heap - r->c.freed));
+    for (int b = 0; b < PROF_BUCKETS; ++b)
+      if (r->c.hist[b])
+        fprintf(out, " %s-%s:%lld", prof_size((int64_t)1 << b, lo, sizeof lo),
+                prof_size((int64_t)2 << b, hi, sizeof hi), (long long)r->c.hist[b]);
+    fputc('\n', out);
+  }
+  if (out != stderr) fclose(out);
+}
+
+/* parallel for: a work-stealing pool. CodeGen outlines the loop body into
+   body(env, lo, hi), which runs the iterations from lo up to hi. The runtime
+   sees the iterations as indices 0..n, with index k meaning begin + k*step. */
+typedef void (*aurora_body)(void* env, int64_t lo, int64_t hi);
+
+/* Chase-Lev deque of index ranges (and spawned tasks, below). Each thread splits its range lazily: it
+   pushes half of it only when its own deque is empty. A deque therefore holds
+   at most a few entries. Slots are atomics so a thief can read one while the
+   owner pushes. */
+#define DEQ_CAP 64
+typedef struct {
+  _Alignas(64) atomic_llong top;
+  _Alignas(64) atomic_llong bottom;
+  atomic_llong lo[DEQ_CAP], hi[DEQ_CAP];
+} deque;
+
+static int deq_empty(deque* d) {
+  return atomic_load_explicit(&d->bottom, memory_order_relaxed) <= atomic_load_explicit(&d->top, memory_order_relaxed);
+}
+
+static int deq_push(deque* d, int64_t lo, int64_t hi) {
+  long long b = atomic_load_explicit(&d->bottom, memory_order_relaxed);
+  long long t = atomic_load_explicit(&d->top, memory_order_acquire);
+  if (b - t >= DEQ_CAP) return 0;
+  atomic_store_explicit(&d->lo[b & (DEQ_CAP - 1)], lo, memory_order_relaxed);
+  atomic_store_explicit(&d->hi[b & (DEQ_CAP - 1)], hi, memory_order_relaxed);
+  atomic_store_explicit(&d->bottom, b + 1, memory_order_release);
+  return 1;
+}
+
+static int deq_pop(deque* d, int64_t* lo, int64_t* hi) {
+  long long b = atomic_load_explicit(&d->bottom, memory_order_relaxed) - 1;
+  atomic_store_explicit(&d->bottom, b, memory_order_relaxed);
+  atomic_thread_fence(memory_order_seq_cst);
+  long long t = atomic_load_explicit(&d->top, memory_order_relaxed);
+  if (t > b) { atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed); return 0; }
+  *lo = atomic_load_explicit(&d->lo[b & (DEQ_CAP - 1)], memory_order_relaxed);
+  *hi = atomic_load_explicit(&d->hi[b & (DEQ_CAP - 1)], memory_order_relaxed);
+  if (t < b) return 1;
+  /* last entry: race the thieves for it */
+  int won = atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+  atomic_store_explicit(&d->bottom, b + 1, memory_order_relaxed);
+  return won;
+}
+
+static int deq_steal(deque* d, int64_t* lo, int64_t* hi) {
+  long long t = atomic_load_explicit(&d->top, memory_order_acquire);
+  atomic_thread_fence(memory_order_seq_cst);
+  long long b = atomic_load_explicit(&d->bottom, memory_order_acquire);
+  if (t >= b) return 0;
+  *lo = atomic_load_explicit(&d->lo[t & (DEQ_CAP - 1)], memory_order_relaxed);
+  *hi = atomic_load_explicit(&d->hi[t & (DEQ_CAP - 1)], memory_order_relaxed);
+  return atomic_compare_exchange_strong_explicit(&d->top, &t, t + 1, memory_order_seq_cst, memory_order_relaxed);
+}
+
+/* spawn: a task is a frame CodeGen lays out as this header followed by the
+   result and the arguments; run(frame) makes the call. A deque entry holding a
+   task has hi == TASK and lo == the frame's address. Whoever pops or steals the
+   entry clears `queued` once done with the frame, and the frame is not released
+   before that: a joiner may have run the task while its entry was still queued. */
+typedef struct task task;
+struct task {
+  void (*run)(task*);
+  task* next;   /* the spawner's other tasks */
+  task** scope; /* list head in the spawner's frame */
+  atomic_int state;
+  atomic_int queued; /* a deque entry or a thread that removed one still refers to the frame */
+  int big;
+};
+enum { QUEUED, TAKEN, DONE };
+#define TASK (-1)
+#define SMALL_FRAME 128
+
+/* Thread 0 is whichever thread calls aurora_parallel_for or spawns outside the pool;
+   workers are 1..nworkers. Idle workers sleep on `cv` until work_available(). */
+static struct {
+  int nworkers;
+  int spawn_depth; /* a spawn runs inline once the spawner's deque holds this many entries */
+  deque* deq;
+  pthread_mutex_t mu, job;
+  pthread_cond_t cv;
+  /* the running loop; written only while no iterations are outstanding */
+  aurora_body body; void* env; int64_t begin, step, grain;
+  _Alignas(64) atomic_llong remaining; /* iterations not yet finished */
+  _Alignas(64) atomic_llong pending;   /* tasks queued and not yet taken */
+  atomic_int sleepers;
+} pool = { .mu = PTHREAD_MUTEX_INITIALIZER, .job = PTHREAD_MUTEX_INITIALIZER, .cv = PTHREAD_COND_INITIALIZER };
+static pthread_once_t pool_once = PTHREAD_ONCE_INIT;
+static _Thread_local int worker_id = -1; /* >= 0 while running loop iterations */
+static _Thread_local task* free_frames;  /* SMALL_FRAME blocks this thread released */
+
+static int self(void) { return worker_id > 0 ? worker_id : 0; }
+
+static int work_available(void) {
+  return atomic_load(&pool.remaining) > 0 || atomic_load(&pool.pending) > 0;
+}
+
+static void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#endif
+}
+
+/* Back off while waiting on another thread: spin briefly, then give up the CPU. */
+static void backoff(unsigned* spins) {
+  if (++*spins < 64) cpu_relax();
+  else sched_yield();
+}
+
+static void run_task(task* t) {
+  t->run(t);
+  atomic_store_explicit(&t->state, DONE, memory_order_release);
+}
+
+/* Claim a queued task; fails if a joiner or another thread got there first. */
+static int take(task* t) {
+  int s = QUEUED;
+  if (!atomic_compare_exchange_strong(&t->state, &s, TAKEN)) return 0;
+  atomic_fetch_sub(&pool.pending, 1);
+  return 1;
+}
+
+/* Run index range [lo, hi). Work goes out in `grain`-sized calls, and half of what
+   remains is offered to thieves whenever this thread's deque is empty. */
+static void run_range(int id, int64_t lo, int64_t hi) {
+  aurora_body body = pool.body; void* env = pool.env;
+  int64_t begin = pool.begin, step = pool.step, grain = pool.grain;
+  deque* d = &pool.deq[id];
+  while (hi - lo > grain) {
+    if (deq_empty(d) && deq_push(d, lo + (hi - lo) / 2, hi)) { hi = lo + (hi - lo) / 2; continue; }
+    body(env, begin + lo * step, begin + (lo + grain) * step);
+    atomic_fetch_sub_explicit(&pool.remaining, grain, memory_order_acq_rel);
+    lo += grain;
+  }
+  body(env, begin + lo * step, begin + hi * step);
+  atomic_fetch_sub_explicit(&pool.remaining, hi - lo, memory_order_acq_rel);
+}
+
+/* Run a task whose deque entry this thread removed, unless someone got to it first. */
+static void run_taken_entry(task* t) {
+  if (take(t)) run_task(t);
+  atomic_store_explicit(&t->queued, 0, memory_order_release);
+}
+
+static void run_entry(int id, int64_t lo, int64_t hi) {
+  if (hi != TASK) run_range(id, lo, hi);
+  else run_taken_entry((task*)(intptr_t)lo);
+}
+
+/* Pop one entry from this thread's deque, or steal one from a random victim, and run it. */
+static int find_work(int id, unsigned* rng) {
+  int64_t lo, hi;
+  if (deq_pop(&pool.deq[id], &lo, &hi)) { run_entry(id, lo, hi); return 1; }
+  *rng = *rng * 1103515245u + 12345u;
+  int victim = (int)((*rng >> 8) % (unsigned)(pool.nworkers + 1));
+  if (victim == id || !deq_steal(&pool.deq[victim], &lo, &hi)) return 0;
+  run_entry(id, lo, hi);
+  return 1;
+}
+
+static void work_until_done(int id) {
+  unsigned rng = (unsigned)id * 2654435761u + 1;
+  while (atomic_load_explicit(&pool.remaining, memory_order_acquire) > 0)
+    if (!find_work(id, &rng)) cpu_relax();
+}
+
+#ifdef __linux__
+static cpu_set_t pool_cpus; /* the process's affinity mask when the pool started */
+
+/* Pin worker `id` to the id-th CPU the process may run on, leaving the first to the caller. */
+static void pin_worker(int id) {
+  const char* pin = getenv("AURORA_PIN");
+  if (pin && pin[0] == '0') return;
+  int seen = 0;
+  for (int c = 0; c < CPU_SETSIZE; ++c) {
+    if (!CPU_ISSET(c, &pool_cpus)) continue;
+    if (seen++ == id) {
+      cpu_set_t one; CPU_ZERO(&one); CPU_SET(c, &one);
+      pthread_setaffinity_np(pthread_self(), sizeof one, &one);
+      return;
+    }
+  }
+}
+#endif
+
+static void* worker_main(void* arg) {
+  int id = (int)(intptr_t)arg;
+#ifdef __linux__
+  pin_worker(id);
+#endif
+  worker_id = id;
+  unsigned rng = (unsigned)id * 2654435761u + 1, idle = 0;
+  for (;;) {
+    if (find_work(id, &rng)) { idle = 0; continue; }
+    if (++idle < 256) { cpu_relax(); continue; }
+    idle = 0;
+    /* sleepers is raised before work_available() is checked and producers publish work
+       before reading sleepers, so one side always sees the other */
+    pthread_mutex_lock(&pool.mu);
+    atomic_fetch_add(&pool.sleepers, 1);
+    while (!work_available()) pthread_cond_wait(&pool.cv, &pool.mu);
+    atomic_fetch_sub(&pool.sleepers, 1);
+    pthread_mutex_unlock(&pool.mu);
+  }
+  return NULL;
+}
+
+/* One thread per CPU in the affinity mask, or AURORA_THREADS. */
+static void pool_init(void) {
+  int n = 1;
+#ifdef __linux__
+  if (sched_getaffinity(0, sizeof pool_cpus, &pool_cpus) == 0) n = CPU_COUNT(&pool_cpus);
+#endif
+  const char* env = getenv("AURORA_THREADS");
+  if (env && atoi(env) > 0) n = atoi(env);
+  env = getenv("AURORA_SPAWN_DEPTH");
+  pool.spawn_depth = env && atoi(env) > 0 ? atoi(env) : 8;
+  if (pool.spawn_depth > DEQ_CAP) pool.spawn_depth = DEQ_CAP;
+  pool.deq = aligned_alloc(64, sizeof(deque) * (size_t)n);
+  if (!pool.deq) { fputs("aurora: out of memory starting thread pool\n", stderr); abort(); }
+  memset(pool.deq, 0, sizeof(deque) * (size_t)n);
+  /* set before any worker starts looking for victims; a worker that fails to start
+     only leaves an empty deque behind */
+  pool.nworkers = n - 1;
+  for (int id = 1; id < n; ++id) {
+    pthread_t t;
+    if (pthread_create(&t, NULL, worker_main, (void*)(intptr_t)id) != 0) break;
+    pthread_detach(t);
+  }
+}
+
+static void wake(int all) {
+  if (atomic_load(&pool.sleepers) == 0) return;
+  pthread_mutex_lock(&pool.mu);
+  if (all) pthread_cond_broadcast(&pool.cv);
+  else pthread_cond_signal(&pool.cv);
+  pthread_mutex_unlock(&pool.mu);
+}
+
+/* Runs body over begin, begin+step, ... (n iterations) on the pool and returns when all are done.
+   A parallel for inside another one, or racing one on another thread, runs on the calling thread. */
+void aurora_parallel_for(aurora_body body, void* env, int64_t begin, int64_t n, int64_t step) {
+  if (n <= 0) return;
+  pthread_once(&pool_once, pool_init);
+  if (pool.nworkers == 0 || n == 1 || worker_id >= 0 || pthread_mutex_trylock(&pool.job) != 0) {
+    body(env, begin, begin + n * step);
+    return;
+  }
+  int64_t grain = n / ((int64_t)(pool.nworkers + 1) * 64);
+  pool.body = body; pool.env = env; pool.begin = begin; pool.step = step; pool.grain = grain > 0 ? grain : 1;
+  atomic_store(&pool.remaining, n);
+  deq_push(&pool.deq[0], 0, n);
+  wake(1);
+  worker_id = 0;
+  work_until_done(0);
+  worker_id = -1;
+  pthread_mutex_unlock(&pool.job);
+}
+
+/* A frame for `spawn`, linked into the spawner's scope so aurora_scope_end can release it.
+   Frames are taken and released by the spawning thread only, and a released frame has no
+   deque entry left, so nothing else sees it until aurora_spawn queues it again. */
+task* aurora_task_new(int64_t size, void (*run)(task*), task** scope) {
+  task* t;
+  if (size <= SMALL_FRAME && free_frames) { t = free_frames; free_frames = t->next; }
+  else t = aligned_alloc(64, size <= SMALL_FRAME ? SMALL_FRAME : (size_t)(size + 63) & ~(size_t)63);
+  if (!t) { fputs("aurora: out of memory spawning a task\n", stderr); abort(); }
+  t->run = run;
+  t->next = *scope; *scope = t;
+  t->scope = scope;
+  atomic_store_explicit(&t->state, TAKEN, memory_order_relaxed);
+  atomic_store_explicit(&t->queued, 0, memory_order_relaxed);
+  t->big = size > SMALL_FRAME;
+  return t;
+}
+
+/* Offer the task to idle workers, or run it now when the pool is absent or the
+   spawner's deque is already spawn_depth deep (enough parallelism is exposed).
+   CodeGen has stored the arguments by now; the release store publishes them. */
+void aurora_spawn(task* t) {
+  pthread_once(&pool_once, pool_init);
+  deque* d = &pool.deq[self()];
+  long long depth = atomic_load_explicit(&d->bottom, memory_order_relaxed) - atomic_load_explicit(&d->top, memory_order_relaxed);
+  if (pool.nworkers > 0 && depth < pool.spawn_depth) {
+    atomic_fetch_add(&pool.pending, 1);
+    atomic_store_explicit(&t->queued, 1, memory_order_relaxed);
+    atomic_store_explicit(&t->state, QUEUED, memory_order_release);
+    if (deq_push(d, (int64_t)(intptr_t)t, TASK)) { wake(0); return; }
+    atomic_store_explicit(&t->state, TAKEN, memory_order_relaxed);
+    atomic_store_explicit(&t->queued, 0, memory_order_relaxed);
+    atomic_fetch_sub(&pool.pending, 1);
+  }
+  run_task(t);
+}
+
+/* Wait for one task: run it here if nobody has started it, else help with other work. */
+void aurora_join(task* t) {
+  if (take(t)) { run_task(t); return; }
+  unsigned rng = (unsigned)self() * 2654435761u + 1, spins = 0;
+  while (atomic_load_explicit(&t->state, memory_order_acquire) != DONE)
+    if (!find_work(self(), &rng)) backoff(&spins);
+}
+
+/* Wait for every task spawned into `scope`. Entries for them sit on top of this
+   thread's deque (callees clear theirs before returning); pop and run or discard
+   those, then help until the stolen ones finish. No deque entry refers to the
+   scope's frames afterwards. */
+void aurora_sync(task** scope) {
+  if (!*scope) return;
+  deque* d = &pool.deq[self()];
+  int64_t lo, hi;
+  while (deq_pop(d, &lo, &hi)) {
+    task* t = (task*)(intptr_t)lo;
+    if (hi != TASK || t->scope != scope) { deq_push(d, lo, hi); break; }
+    run_taken_entry(t);
+  }
+  unsigned rng = (unsigned)self() * 2654435761u + 1, spins = 0;
+  for (task* t = *scope; t; t = t->next)
+    while (atomic_load_explicit(&t->state, memory_order_acquire) != DONE)
+      if (!find_work(self(), &rng)) backoff(&spins);
+}
+
+/* The spawning function is returning: wait for its tasks, and for thieves still holding an
+   entry of one a joiner ran, then release their frames. */
+void aurora_scope_end(task** scope) {
+  aurora_sync(scope);
+  for (task* t = *scope, *next; t; t = next) {
+    next = t->next;
+    unsigned spins = 0;
+    while (atomic_load_explicit(&t->queued, memory_order_acquire)) backoff(&spins);
+    if (t->big) free(t);
+    else { t->next = free_frames; free_frames = t; }
+  }
+  *scope = NULL;
+}
+
+/* Channels: bounded rings of fixed-size elements. The MPMC ring is Vyukov's: each cell
+   carries a sequence number telling producers and consumers whose turn it is. The SPSC
+   ring keeps only a head and a tail, each side caching the other's index. A blocked
+   send/recv spins briefly, then parks on a futex word the other side bumps. */
+typedef struct {
+  int64_t esz, stride; /* element size; bytes per cell */
+  size_t mask;         /* capacity - 1 (a power of two >= 2) */
+  int spsc;
+  char* cells;
+  _Alignas(64) atomic_size_t head; /* next cell to fill */
+  size_t tail_cache;               /* spsc producer's view of tail */
+  _Alignas(64) atomic_size_t tail; /* next cell to drain */
+  size_t head_cache;               /* spsc consumer's view of head */
+  _Alignas(64) atomic_uint not_empty, not_full; /* futex words */
+  atomic_int recv_waiters, send_waiters;
+} aurora_chan;
+
+static atomic_size_t* cell_seq(aurora_chan* ch, size_t pos) {
+  return (atomic_size_t*)(ch->cells + (int64_t)(pos & ch->mask) * ch->stride);
+}
+static char* cell_data(aurora_chan* ch, size_t pos) {
+  return ch->cells + (int64_t)(pos & ch->mask) * ch->stride + (ch->spsc ? 0 : sizeof(atomic_size_t));
+}
+
+static void chan_oom(void) { fputs("aurora: out of memory creating a channel\n", stderr); abort(); }
+
+aurora_chan* aurora_chan_new(int64_t esz, int64_t cap, int32_t spsc) {
+  int64_t stride = ((spsc ? 0 : (int64_t)sizeof(atomic_size_t)) + esz + 7) & ~(int64_t)7;
+  size_t n = 2;
+  while ((int64_t)n < cap) {
+    if (n > (size_t)PTRDIFF_MAX / 2 / (size_t)(stride ? stride : 1)) chan_oom(); /* the cells would not fit in memory */
+    n <<= 1;
+  }
+  aurora_chan* ch = aligned_alloc(64, sizeof(aurora_chan));
+  if (!ch) chan_oom();
+  memset(ch, 0, sizeof *ch);
+  ch->esz = esz;
+  ch->spsc = spsc;
+  ch->stride = stride;
+  ch->mask = n - 1;
+  ch->cells = aligned_alloc(64, (n * (size_t)stride + 63) & ~(size_t)63);
+  if (!ch->cells) chan_oom();
+  if (!spsc) for (size_t i = 0; i < n; ++i) atomic_init(cell_seq(ch, i), i);
+  return ch;
+}
+
+void aurora_chan_free(aurora_chan* ch) {
+  free(ch->cells);
+  free(ch);
+}
+
+static void futex_wait(atomic_uint* word, unsigned seen) {
+#ifdef __linux__
+  syscall(SYS_futex, (unsigned*)word, FUTEX_WAIT_PRIVATE, seen, NULL, NULL, 0);
+#else
+  (void)word; (void)seen;
+  sched_yield();
+#endif
+}
+
+static void futex_wake(atomic_uint* word) {
+#ifdef __linux__
+  syscall(SYS_futex, (unsigned*)word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+#else
+  (void)word;
+#endif
+}
+
+/* After a successful operation: let one parked thread on the other side retry. The fence
+   orders our head/tail update before the waiter count is read (see park). */
+static void unpark(atomic_uint* word, atomic_int* waiters) {
+  atomic_thread_fence(memory_order_seq_cst);
+  if (atomic_load_explicit(waiters, memory_order_relaxed) == 0) return;
+  atomic_fetch_add(word, 1);
+  futex_wake(word);
+}
+
+static int chan_full(aurora_chan* ch) {
+  return atomic_load(&ch->head) - atomic_load(&ch->tail) > ch->mask;
+}
+static int chan_empty(aurora_chan* ch) {
+  return atomic_load(&ch->head) == atomic_load(&ch->tail);
+}
+
+static int chan_put(aurora_chan* ch, const void* src) {
+  if (ch->spsc) {
+    size_t h = atomic_load_explicit(&ch->head, memory_order_relaxed);
+    if (h - ch->tail_cache > ch->mask) {
+      ch->tail_cache = atomic_load_explicit(&ch->tail, memory_order_acquire);
+      if (h - ch->tail_cache > ch->mask) return 0;
+    }
+    memcpy(cell_data(ch, h), src, (size_t)ch->esz);
+    atomic_store_explicit(&ch->head, h + 1, memory_order_release);
+    return 1;
+  }
+  size_t pos = atomic_load_explicit(&ch->head, memory_order_relaxed);
+  for (;;) {
+    intptr_t diff = (intptr_t)atomic_load_explicit(cell_seq(ch, pos), memory_order_acquire) - (intptr_t)pos;
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&ch->head, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+    } else if (diff < 0) return 0; /* the cell still holds an element from the previous lap */
+    else pos = atomic_load_explicit(&ch->head, memory_order_relaxed);
+  }
+  memcpy(cell_data(ch, pos), src, (size_t)ch->esz);
+  atomic_store_explicit(cell_seq(ch, pos), pos + 1, memory_order_release);
+  return 1;
+}
+
+static int chan_take(aurora_chan* ch, void* dst) {
+  if (ch->spsc) {
+    size_t t = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+    if (t == ch->head_cache) {
+      ch->head_cache = atomic_load_explicit(&ch->head, memory_order_acquire);
+      if (t == ch->head_cache) return 0;
+    }
+    memcpy(dst, cell_data(ch, t), (size_t)ch->esz);
+    atomic_store_explicit(&ch->tail, t + 1, memory_order_release);
+    return 1;
+  }
+  size_t pos = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+  for (;;) {
+    intptr_t diff = (intptr_t)atomic_load_explicit(cell_seq(ch, pos), memory_order_acquire) - (intptr_t)(pos + 1);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&ch->tail, &pos, pos + 1, memory_order_relaxed, memory_order_relaxed)) break;
+    } else if (diff < 0) return 0; /* not filled yet */
+    else pos = atomic_load_explicit(&ch->tail, memory_order_relaxed);
+  }
+  memcpy(dst, cell_data(ch, pos), (size_t)ch->esz);
+  atomic_store_explicit(cell_seq(ch, pos), pos + ch->mask + 1, memory_order_release);
+  return 1;
+}
+
+int32_t aurora_chan_try_send(aurora_chan* ch, const void* src) {
+  if (!chan_put(ch, src)) return 0;
+  unpark(&ch->not_empty, &ch->recv_waiters);
+  return 1;
+}
+
+int32_t aurora_chan_try_recv(aurora_chan* ch, void* dst) {
+  if (!chan_take(ch, dst)) return 0;
+  unpark(&ch->not_full, &ch->send_waiters);
+  return 1;
+}
+
+/* Sleep until `word` moves, unless `blocked` no longer holds once we are counted as a
+   waiter. Aurora threads all come from the pool, so with no workers nobody can wake us. */
+static void park(aurora_chan* ch, atomic_uint* word, atomic_int* waiters, int (*blocked)(aurora_chan*), const char* what) {
+  if (pool.nworkers == 0) {
+    fprintf(stderr, "aurora: %s would block forever: no other thread (AURORA_THREADS=1?)\n", what);
+    abort();
+  }
+  unsigned seen = atomic_load(word);
+  atomic_fetch_add(waiters, 1);
+  atomic_thread_fence(memory_order_seq_cst);
+  if (blocked(ch)) futex_wait(word, seen);
+  atomic_fetch_sub(waiters, 1);
+}
+
+void aurora_chan_send(aurora_chan* ch, const void* src) {
+  for (unsigned spins = 0; !aurora_chan_try_send(ch, src); ++spins) {
+    if (spins < 128) cpu_relax();
+    else park(ch, &ch->not_full, &ch->send_waiters, chan_full, "send on a full channel");
+  }
+}
+
+void aurora_chan_recv(aurora_chan* ch, void* dst) {
+  for (unsigned spins = 0; !aurora_chan_try_recv(ch, dst); ++spins) {
+    if (spins < 128) cpu_relax();
+    else park(ch, &ch->not_empty, &ch->recv_waiters, chan_empty, "recv on an empty channel");
+  }
+}
+
+/* ---- I/O ----
+   stdout goes through one buffer written with write(2)/writev(2), never through stdio: it is
+   flushed when full, at exit, before reads, and after every line when stdout is a terminal.
+   Single-threaded programs use it unlocked; once the pool has workers a spinlock guards it. */
+
+#define OUT_CAP ((size_t)1 << 16)
+
+static struct {
+  char buf[OUT_CAP];
+  size_t len;
+  int state; /* 0 = unused, 1 = pipe or file, 2 = terminal */
+  atomic_flag busy;
+} out = { .busy = ATOMIC_FLAG_INIT };
+
+static const char digit_pairs[201] =
+  "0001020304050607080910111213141516171819202122232425262728293031323334353637383940414243444546474849"
+  "5051525354555657585960616263646566676869707172737475767778798081828384858687888990919293949596979899";
+
+static void write_all(const struct iovec* iov, int n) {
+  struct iovec v[2];
+  memcpy(v, iov, sizeof(struct iovec) * (size_t)n);
+  while (n > 0) {
+    ssize_t w = writev(1, v, n);
+    if (w < 0 && errno == EINTR) continue;
+    if (w < 0) return; /* stdout closed or broken: drop the output, as stdio would */
+    while (n > 0 && (size_t)w >= v[0].iov_len) { w -= (ssize_t)v[0].iov_len; v[0] = v[1]; --n; }
+    if (n > 0) { v[0].iov_base = (char*)v[0].iov_base + w; v[0].iov_len -= (size_t)w; }
+  }
+}
+
+static void out_flush_locked(void) {
+  if (out.len == 0) return;
+  struct iovec v = { out.buf, out.len };
+  write_all(&v, 1);
+  out.len = 0;
+}
+
+static void aurora_flush(void);
+
+/* First output only; out of line so that out_lock inlines into every writer. */
+__attribute__((cold, noinline)) static void out_start(void) {
+  out.state = isatty(1) ? 2 : 1;
+  atexit(aurora_flush);
+}
+
+static inline int out_lock(void) {
+  int locked = pool.nworkers > 0; /* otherwise no other thread exists */
+  if (locked)
+    while (atomic_flag_test_and_set_explicit(&out.busy, memory_order_acquire)) cpu_relax();
+  if (__builtin_expect(out.state == 0, 0)) out_start();
+  return locked;
+}
+
+static void out_unlock(int locked) {
+  if (out.state == 2) out_flush_locked();
+  if (locked) atomic_flag_clear_explicit(&out.busy, memory_order_release);
+}
+
+static void aurora_flush(void) {
+  int locked = out_lock();
+  out_flush_locked();
+  out_unlock(locked);
+}
+
+/* Eight digits of x < 10^8 at p: the four pairs do not depend on each other. */
+static void format_8(char* p, uint32_t x) {
+  uint32_t hi = x / 10000, lo = x % 10000;
+  memcpy(p, digit_pairs + 2 * (hi / 100), 2);
+  memcpy(p + 2, digit_pairs + 2 * (hi % 100), 2);
+  memcpy(p + 4, digit_pairs + 2 * (lo / 100), 2);
+  memcpy(p + 6, digit_pairs + 2 * (lo % 100), 2);
+}
+
+/* Digits of x < 10^8, left to right, with no digit count up front: t / 2^57 is x scaled so that
+   its leading one or two digits are the integer part, and each further pair is the integer part
+   of the fraction times 100. A single leading digit is copied with the byte after it, which the
+   next pair or the caller overwrites. Returns the end of the digits. */
+#define FRAC57 (((uint64_t)1 << 57) - 1)
+static char* format_lead(char* p, uint32_t x) {
+  uint64_t t;
+  int pairs, two; /* two: the leading pair has both digits; from x, not t, so the end is known early */
+  if (x < 100) { t = (uint64_t)x << 57; pairs = 0; two = x >= 10; }
+  else if (x < 10000) { t = (uint64_t)x * 1441151880758559ull; pairs = 1; two = x >= 1000; }  /* 2^57/10^2 */
+  else if (x < 1000000) { t = (uint64_t)x * 14411518807586ull; pairs = 2; two = x >= 100000; } /* 2^57/10^4 */
+  else { t = (uint64_t)x * 144115188076ull; pairs = 3; two = x >= 10000000; }                  /* 2^57/10^6 */
+  uint32_t first = (uint32_t)(t >> 57);
+  memcpy(p, digit_pairs + 2 * first + !two, 2);
+  p += 1 + two;
+  for (; pairs > 0; --pairs) {
+    t = (t & FRAC57) * 100;
+    memcpy(p, digit_pairs + 2 * (t >> 57), 2);
+    p += 2;
+  }
+  return p;
+}
+
+/* All digits of v at p; returns the end. Blocks after the leading one are eight digits each. */
+static char* format_u64(char* p, uint64_t v) {
+  if (v < 100000000) return format_lead(p, (uint32_t)v);
+  if (v < 10000000000000000ull) {
+    p = format_lead(p, (uint32_t)(v / 100000000));
+  } else {
+    p = format_lead(p, (uint32_t)(v / 10000000000000000ull));
+    v %= 10000000000000000ull;
+    format_8(p, (uint32_t)(v / 100000000));
+    p += 8;
+  }
+  format_8(p, (uint32_t)(v % 100000000));
+  return p + 8;
+}
+
+/* Formats straight into the buffer, left to right. */
+int64_t print_i64(int64_t x) {
+  int locked = out_lock();
+  if (OUT_CAP - out.len < 21) out_flush_locked(); /* sign, 19 digits, newline */
+  char* p = out.buf + out.len;
+  uint64_t u = x < 0 ? 0 - (uint64_t)x : (uint64_t)x;
+  if (x < 0) *p++ = '-';
+  p = format_u64(p, u);
+  *p = '\n';
+  out.len = (size_t)(p + 1 - out.buf);
+  out_unlock(locked);
+  return x;
+}
+
+/* stdin is mapped whole when it is a regular file, otherwise read in IN_CAP chunks; read_i64
+   parses straight from the mapping or the buffer. stdout is flushed before every read(2) that
+   might block, not before every read_i64. */
+
+#define IN_CAP ((size_t)1 << 16)
+
+static struct {
+  const char *p, *end; /* unparsed input */
+  char* buf;
+  int state; /* 0 = not started, 1 = reading chunks, 2 = mapped, 3 = at end of input */
+  atomic_flag busy;
+} in = { .busy = ATOMIC_FLAG_INIT };
+
+static void io_fail(const char* msg) {
+  aurora_flush();
+  fprintf(stderr, "aurora: %s\n", msg);
+  abort();
+}
+
+static void in_start(void) {
+  struct stat st;
+  off_t at = lseek(0, 0, SEEK_CUR);
+  if (fstat(0, &st) == 0 && S_ISREG(st.st_mode) && at >= 0 && st.st_size > at) {
+#ifdef MAP_POPULATE
+    int flags = MAP_PRIVATE | MAP_POPULATE; /* input is normally read to the end: fault it in at once */
+#else
+    int flags = MAP_PRIVATE;
+#endif
+    void* m = mmap(NULL, (size_t)st.st_size, PROT_READ, flags, 0, 0);
+    if (m != MAP_FAILED) {
+      madvise(m, (size_t)st.st_size, MADV_SEQUENTIAL);
+      in.p = (const char*)m + at;
+      in.end = (const char*)m + st.st_size;
+      in.state = 2;
+      return;
+    }
+  }
+  in.buf = malloc(IN_CAP);
+  if (!in.buf) io_fail("out of memory for the input buffer");
+  in.p = in.end = in.buf;
+  in.state = 1;
+}
+
+/* Replaces the consumed buffer with the next chunk; 0 at end of input. */
+static int in_fill(void) {
+  if (in.state == 0) {
+    in_start();
+    if (in.state == 2) return 1;
+  }
+  if (in.state != 1) { in.state = 3; return 0; }
+  aurora_flush(); /* prompts written so far must be visible before we block */
+  ssize_t n;
+  do n = read(0, in.buf, IN_CAP); while (n < 0 && errno == EINTR);
+  if (n < 0) io_fail("read_i64: cannot read stdin");
+  if (n == 0) { in.state = 3; return 0; }
+  in.p = in.buf;
+  in.end = in.buf + n;
+  return 1;
+}
+
+static int in_lock(void) {
+  int locked = pool.nworkers > 0;
+  if (locked)
+    while (atomic_flag_test_and_set_explicit(&in.busy, memory_order_acquire)) cpu_relax();
+  return locked;
+}
+
+static void in_unlock(int locked) {
+  if (locked) atomic_flag_clear_explicit(&in.busy, memory_order_release);
+}
+
+/* Skips whitespace, then an optional '-' and decimal digits; 0 at end of input. A token that
+   is not an integer, or one that does not fit in i64, stops the program. */
+static int64_t parse_i64(void) {
+  for (;;) {
+    while (in.p < in.end && (unsigned char)*in.p <= ' ') ++in.p;
+    if (in.p < in.end) break;
+    if (in.state == 3 || !in_fill()) return 0;
+  }
+  int neg = *in.p == '-';
+  if (neg) ++in.p;
+  /* v * 10 + d overflows once v reaches max / 10; only then is the last digit compared */
+  const uint64_t tenth = (uint64_t)INT64_MAX / 10, last = neg ? 8 : 7;
+  uint64_t v = 0;
+  int any = 0;
+  for (;;) {
+    const char* q = in.p;
+    while (q < in.end) {
+      unsigned d = (unsigned)(unsigned char)*q - '0';
+      if (d > 9) break;
+      if (v >= tenth && (v > tenth || d > last)) io_fail("stdin: integer does not fit in i64");
+      v = v * 10 + d;
+      ++q;
+    }
+    any |= q != in.p;
+    in.p = q;
+    if (q < in.end || in.state == 3 || !in_fill()) break;
+  }
+  if (!any) io_fail("stdin: expected an integer");
+  return neg ? (int64_t)(0 - v) : (int64_t)v;
+}
+
+int64_t read_i64(void) {
+  int locked = in_lock();
+  int64_t v = parse_i64();
+  in_unlock(locked);
+  return v;
+}
+
+/* SWAR on eight input bytes, first character in the low byte. digit_run counts the leading
+   decimal digits; eight_digits converts them, the missing ones shifted in as leading zeros. */
+static unsigned digit_run(uint64_t x) {
+  const uint64_t lo = 0x0F0F0F0F0F0F0F0Full, hi = 0xF0F0F0F0F0F0F0F0ull, ones = 0x0101010101010101ull;
+  uint64_t bad = ((x & hi) ^ 0x3030303030303030ull) | (((x & lo) + 6 * ones) & hi);
+  uint64_t flag = (((bad & 0x7F7F7F7F7F7F7F7Full) + 0x7F7F7F7F7F7F7F7Full) | bad) & 0x8080808080808080ull;
+  return flag ? (unsigned)__builtin_ctzll(flag) >> 3 : 8;
+}
+
+static uint64_t eight_digits(uint64_t x, unsigned n) {
+  x = n ? x << (8 * (8 - n)) : 0;
+  x = (x & 0x0F0F0F0F0F0F0F0Full) * 2561 >> 8;
+  x = (x & 0x00FF00FF00FF00FFull) * 6553601 >> 16;
+  return (x & 0x0000FFFF0000FFFFull) * 42949672960001ull >> 32;
+}
+
+/* Reads n integers into dst. Tokens well inside the buffer are classified and converted eight
+   bytes at a time; those near its end, or longer than 18 digits, go through parse_i64. */
+void aurora_read_array_i64(int64_t* dst, int64_t len, int64_t n) {
+  static const uint64_t pow10_8[9] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000 };
+  if (n < 0 || n > len) io_fail("read_array_i64: count exceeds the destination's length");
+  int locked = in_lock();
+  for (int64_t i = 0; i < n; ++i) {
+    const char* p = in.p;
+    while (p < in.end && (unsigned char)*p <= ' ') ++p;
+    if (in.end - p < 32) { in.p = p; dst[i] = parse_i64(); continue; }
+    int neg = *p == '-';
+    const char* q = p + neg;
+    uint64_t v = 0;
+    unsigned total = 0, k;
+    do {
+      uint64_t x;
+      memcpy(&x, q, 8);
+      k = digit_run(x);
+      v = v * pow10_8[k] + eight_digits(x, k);
+      q += k;
+      total += k;
+    } while (k == 8 && total < 24);
+    if (total == 0 || total > 18) { in.p = p; dst[i] = parse_i64(); continue; }
+    in.p = q;
+    dst[i] = neg ? (int64_t)(0 - v) : (int64_t)v;
+  }
+  in_unlock(locked);
+}
+
+/* Writes n integers separated by the byte sep, then a newline, under one lock. */
+void aurora_print_array_i64(const int64_t* src, int64_t len, int64_t n, int64_t sep) {
+  if (n < 0 || n > len) io_fail("print_array_i64: count exceeds the source's length");
+  int locked = out_lock();
+  for (int64_t i = 0; i < n; ++i) {
+    if (OUT_CAP - out.len < 21) out_flush_locked();
+    char* p = out.buf + out.len;
+    int64_t x = src[i];
+    uint64_t u = x < 0 ? 0 - (uint64_t)x : (uint64_t)x;
+    if (x < 0) *p++ = '-';
+    p = format_u64(p, u);
+    *p = i + 1 < n ? (char)sep : '\n';
+    out.len = (size_t)(p + 1 - out.buf);
+  }
+  if (n == 0) {
+    if (out.len == OUT_CAP) out_flush_locked();
+    out.buf[out.len++] = '\n';
+  }
+  out_unlock(locked);
+}
+
+/* ---- Files ----
+   map_array<T>(path) views a whole file through a read-only private mapping: nothing is read
+   or parsed up front, pages are faulted in on first touch. The hint bits come from Sema. */
+
+#define AURORA_MAP_SEQUENTIAL 1
+#define AURORA_MAP_RANDOM 2
+#define AURORA_MAP_WILLNEED 4
+#define AURORA_MAP_HUGEPAGE 8
+
+static void file_fail(const char* what, const char* path, const char* why) {
+  aurora_flush();
+  fprintf(stderr, "aurora: %s %s: %s\n", what, path, why);
+  abort();
+}
+
+void* aurora_map_file(const char* path, int64_t esz, int64_t hints, int64_t* count) {
+  int fd = open(path, O_RDONLY | O_CLOEXEC);
+  if (fd < 0) file_fail("map_array: cannot open", path, strerror(errno));
+  struct stat st;
+  if (fstat(fd, &st) != 0) file_fail("map_array: cannot stat", path, strerror(errno));
+  if (!S_ISREG(st.st_mode)) file_fail("map_array: cannot map", path, "not a regular file");
+  if (st.st_size % esz != 0) file_fail("map_array: cannot map", path, "size is not a multiple of the element size");
+  *count = st.st_size / esz;
+  if (st.st_size == 0) { close(fd); return NULL; }
+  /* the slice is writable in the language: stores copy the page and never reach the file */
+  void* m = mmap(NULL, (size_t)st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+  if (m == MAP_FAILED) file_fail("map_array: cannot map", path, strerror(errno));
+  close(fd); /* the mapping keeps the file */
+  size_t bytes = (size_t)st.st_size;
+  if (hints & AURORA_MAP_SEQUENTIAL) madvise(m, bytes, MADV_SEQUENTIAL);
+  if (hints & AURORA_MAP_RANDOM) madvise(m, bytes, MADV_RANDOM);
+  if (hints & AURORA_MAP_WILLNEED) madvise(m, bytes, MADV_WILLNEED); /* starts readahead, does not wait */
+#ifdef MADV_HUGEPAGE
+  if (hints & AURORA_MAP_HUGEPAGE) madvise(m, bytes, MADV_HUGEPAGE); /* honored where the kernel has file THP */
+#endif
+  return m;
+}
+
+void aurora_unmap(void* data, int64_t len, int64_t esz) {
+  if (data && len > 0) munmap(data, (size_t)len * (size_t)esz);
+}
+
+/* Writes the raw bytes of src[0..n) to path, replacing the file. */
+void aurora_write_file(const char* path, const void* data, int64_t len, int64_t n, int64_t esz) {
+  if (n < 0 || n > len) io_fail("write_array_bin: count exceeds the source's length");
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) file_fail("write_array_bin: cannot create", path, strerror(errno));
+  const char* p = data;
+  size_t left = (size_t)n * (size_t)esz;
+  while (left > 0) {
+    ssize_t w = write(fd, p, left);
+    if (w < 0 && errno == EINTR) continue;
+    if (w < 0) file_fail("write_array_bin: cannot write", path, strerror(errno));
+    p += w;
+    left -= (size_t)w;
+  }
+  if (close(fd) != 0) file_fail("write_array_bin: cannot write", path, strerror(errno));
+}